@@ -1,6 +1,7 @@
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <iostream>
 
 class Axis
 {
@@ -8,7 +9,7 @@ public:
 
     Axis() = default;
 
-    static void PrintAxis(size_t characterSize, const std::vector<std::pair<std::string, float>>& labels)
+    static void PrintAxis(size_t characterSize, const std::vector<std::pair<std::string, float>>& labels, std::ostream& os = std::cout)
     {
         const size_t axisLength = characterSize + 2;
         std::string str(axisLength, ' ');
@@ -53,10 +54,10 @@ public:
         charMap['-'] = "─";
         charMap['+'] = "┴";
 
-        std::cout << str << " [Hz]\n";
+        os << str << " [Hz]\n";
         for (char c: str2)
         {
-            std::cout << charMap[c];
+            os << charMap[c];
         }
     }
 };
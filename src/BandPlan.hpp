@@ -0,0 +1,190 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "SpectrumKernels.hpp"
+
+// Precomputed mapping from FFT bins to the log-scaled display bands.
+// Neighbouring bands that read the same bin range are merged into one segment,
+// so a frame only costs one sum and one log10 per segment.
+// The input is the power of each bin; a single-bin segment is converted to dB directly from it,
+// only segments spanning several bins need the magnitudes (square roots) to be summed.
+class BandPlan
+{
+public:
+
+    struct Segment
+    {
+        std::uint32_t binBegin = 0;
+        std::uint32_t binEnd = 0;
+        std::uint32_t bandEnd = 0;
+        float weightDb = 0.0f;
+        float levelScale = 10.0f;
+    };
+
+    BandPlan() = default;
+
+    bool matches(size_t bandCount, float unitFreq, float freqMin, float freqMax, float logBase, float bottomLevel, float topLevel)const
+    {
+        return built
+            && this->bandCount == bandCount
+            && this->unitFreq == unitFreq
+            && this->freqMin == freqMin
+            && this->freqMax == freqMax
+            && this->logBase == logBase
+            && this->bottomLevel == bottomLevel
+            && this->topLevel == topLevel;
+    }
+
+    void build(size_t bandCount, size_t binCount, float unitFreq, float freqMin, float freqMax, float logBase, float bottomLevel, float topLevel)
+    {
+        this->bandCount = bandCount;
+        this->unitFreq = unitFreq;
+        this->freqMin = freqMin;
+        this->freqMax = freqMax;
+        this->logBase = logBase;
+        this->bottomLevel = bottomLevel;
+        this->topLevel = topLevel;
+        built = true;
+
+        invRange = 1.0f / (topLevel - bottomLevel);
+        maxBin = 0;
+        segments.clear();
+
+        BuildSegments(bandCount, binCount, unitFreq, freqMin, freqMax, logBase, [&](const Segment& segment)
+        {
+            segments.push_back(segment);
+            maxBin = std::max(maxBin, static_cast<size_t>(segment.binEnd));
+        });
+    }
+
+    // powers must hold at least binLimit() values.
+    // offsetDb is added to the level of every segment, e.g. the FFT normalization in dB of magnitude.
+    void apply(const float* powers, float offsetDb, std::vector<float>& spectrum)
+    {
+        spectrum.resize(bandCount);
+        segmentLevels.resize(segments.size());
+
+        ApplySegments(segments.data(), segments.size(), powers, offsetDb, bottomLevel, invRange, segmentLevels.data(), spectrum.data());
+    }
+
+    // Calls emit(const Segment&) for the segments of bandCount bands, in band order.
+    // Shared with plans that keep their segments in fixed storage, see FixedSpectrumAnalyzer.
+    template<class Func>
+    static void BuildSegments(size_t bandCount, size_t binCount, float unitFreq, float freqMin, float freqMax, float logBase, Func&& emit)
+    {
+        const float logFreqMin = std::pow(freqMin, 1.0f / logBase);
+        const float logFreqMax = std::pow(freqMax, 1.0f / logBase);
+
+        const auto getBinIndex = [&](size_t i)
+        {
+            const float t = 1.0 * i / bandCount;
+            const float logFreq = logFreqMin + (logFreqMax - logFreqMin) * t;
+            const int index = static_cast<int>(std::floor(std::pow(logFreq, logBase) / unitFreq));
+            return std::clamp(index, 0, static_cast<int>(binCount) - 1);
+        };
+
+        Segment segment;
+        bool pending = false;
+
+        int index1 = getBinIndex(0);
+        int lastIndex0 = -1;
+        int lastIndex1 = -1;
+        for (size_t i = 0; i < bandCount; ++i)
+        {
+            const int index0 = index1;
+            index1 = getBinIndex(i + 1);
+
+            // the weighting depends on the unclamped range, so only identical ranges share a segment
+            if (index0 == lastIndex0 && index1 == lastIndex1)
+            {
+                segment.bandEnd = i + 1;
+                continue;
+            }
+            lastIndex0 = index0;
+            lastIndex1 = index1;
+
+            if (pending)
+            {
+                emit(segment);
+            }
+            pending = true;
+
+            const std::uint32_t binBegin = index0;
+            const std::uint32_t binEnd = std::max(index0 + 1, index1);
+
+            segment.binBegin = binBegin;
+            segment.binEnd = binEnd;
+            segment.bandEnd = i + 1;
+            segment.weightDb = 10.0f * std::log10(DWeighting(unitFreq * (index0 + index1) * 0.5f));
+            segment.levelScale = binEnd - binBegin == 1 ? 5.0f : 10.0f;
+        }
+
+        if (pending)
+        {
+            emit(segment);
+        }
+    }
+
+    // Writes the value of every band covered by the segments to spectrum.
+    // levels is scratch space for one value per segment.
+    static void ApplySegments(const Segment* segments, size_t segmentCount, const float* powers, float offsetDb, float bottomLevel, float invRange, float* levels, float* spectrum)
+    {
+        for (size_t i = 0; i < segmentCount; ++i)
+        {
+            const auto& segment = segments[i];
+            const std::uint32_t count = segment.binEnd - segment.binBegin;
+            levels[i] = count == 1 ? powers[segment.binBegin] : SpectrumKernels::SumSqrt(powers + segment.binBegin, count);
+        }
+
+        SpectrumKernels::Log10(levels, levels, segmentCount);
+
+        std::uint32_t bandBegin = 0;
+        for (size_t i = 0; i < segmentCount; ++i)
+        {
+            const auto& segment = segments[i];
+
+            const float spl = segment.weightDb + offsetDb + segment.levelScale * levels[i];
+            const float loudness = std::max(0.0f, (spl - bottomLevel)) * invRange;
+
+            std::fill(spectrum + bandBegin, spectrum + segment.bandEnd, loudness);
+            bandBegin = segment.bandEnd;
+        }
+    }
+
+    size_t binLimit()const
+    {
+        return maxBin;
+    }
+
+    const std::vector<Segment>& getSegments()const
+    {
+        return segments;
+    }
+
+    static float DWeighting(float f)
+    {
+        const float hf = ((1037918.48f - f * f) * (1037918.48f - f * f) + 1080768.16f * f * f) /
+            ((9837328.0f - f * f) * (9837328.0f - f * f) + 11723776.0f * f * f);
+        return (f / (6.8966888496476f * 1.0e-5f)) * std::sqrt(hf / ((f * f + 79919.29f) * (f * f + 1345600.0f)));
+    }
+
+private:
+
+    std::vector<Segment> segments;
+    std::vector<float> segmentLevels;
+    size_t maxBin = 0;
+
+    size_t bandCount = 0;
+    float unitFreq = 0.0f;
+    float freqMin = 0.0f;
+    float freqMax = 0.0f;
+    float logBase = 0.0f;
+    float bottomLevel = 0.0f;
+    float topLevel = 0.0f;
+    float invRange = 0.0f;
+    bool built = false;
+};
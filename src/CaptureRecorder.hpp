@@ -0,0 +1,161 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+
+// Layout of the recordings written by --record and read back by SoundCapturerReplay.
+//
+// A RecordingHeader is followed by one RecordingBlock per frame of the analyzer, each followed by
+// sampleCount interleaved float32 frames: the samples that arrived since the previous frame, at most
+// the capture buffer. Times are nanoseconds since the recorder was opened, on the steady clock.
+// Everything is in host byte order, like the binary frames of FrameWriter.
+struct RecordingHeader
+{
+    char magic[4];              // "MSAR"
+    std::uint32_t version;      // 1
+    std::uint32_t sampleRate;
+    std::uint32_t channels;
+    std::uint64_t bufferSize;   // samples per channel the capturer kept
+};
+
+struct RecordingBlock
+{
+    std::uint64_t readCount;    // bufferReadCount() of the frame
+    std::int64_t captureTimeNs; // latestSampleTime()
+    std::int64_t frameTimeNs;   // when the frame started
+    std::uint32_t deviceLatencyUs;
+    std::uint32_t sampleCount;
+};
+
+static_assert(sizeof(RecordingHeader) == 24, "RecordingHeader must not contain padding");
+static_assert(sizeof(RecordingBlock) == 32, "RecordingBlock must not contain padding");
+
+// Dumps the samples every frame reads, and when they were captured, for SoundCapturerReplay.
+class CaptureRecorder
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    CaptureRecorder() = default;
+
+    CaptureRecorder(const CaptureRecorder&) = delete;
+    CaptureRecorder& operator=(const CaptureRecorder&) = delete;
+
+    ~CaptureRecorder()
+    {
+        close();
+    }
+
+    bool open(const std::string& path, int sampleRate, size_t channels, size_t bufferSize)
+    {
+        file = std::fopen(path.c_str(), "wb");
+        if (!file)
+        {
+            std::cerr << "error: cannot open \'" << path << "\': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+        filePath = path;
+
+        RecordingHeader header;
+        std::memcpy(header.magic, "MSAR", 4);
+        header.version = 1;
+        header.sampleRate = static_cast<std::uint32_t>(sampleRate);
+        header.channels = static_cast<std::uint32_t>(channels);
+        header.bufferSize = bufferSize;
+        if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+        {
+            return fail();
+        }
+
+        startTime = Clock::now();
+        return true;
+    }
+
+    // Appends the samples read since the previous call. Call once per frame, before it is analyzed.
+    // Returns false, after reporting it, if the recording cannot be written.
+    template<class Capturer>
+    bool write(const Capturer& capturer, Clock::time_point frameStart)
+    {
+        const size_t channels = capturer.channelCount();
+        const size_t bufferCount = capturer.getBuffer(0).size();
+        const size_t readCount = capturer.bufferReadCount();
+        const size_t sampleCount = std::min(readCount - lastReadCount, bufferCount);
+        lastReadCount = readCount;
+
+        RecordingBlock block;
+        block.readCount = readCount;
+        block.captureTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(capturer.latestSampleTime() - startTime).count();
+        block.frameTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(frameStart - startTime).count();
+        block.deviceLatencyUs = static_cast<std::uint32_t>(capturer.deviceLatency().count());
+        block.sampleCount = static_cast<std::uint32_t>(sampleCount);
+        if (std::fwrite(&block, sizeof(block), 1, file) != 1)
+        {
+            return fail();
+        }
+
+        // the latest sampleCount samples end at the head of the ring buffers
+        interleaved.resize(sampleCount * channels);
+        const size_t startIndex = (capturer.bufferHeadIndex() + bufferCount - sampleCount) % std::max<size_t>(1, bufferCount);
+        for (size_t channel = 0; channel < channels; ++channel)
+        {
+            const auto& buffer = capturer.getBuffer(channel);
+            for (size_t i = 0, index = startIndex; i < sampleCount; ++i)
+            {
+                interleaved[i * channels + channel] = buffer[index];
+                index = index + 1 == bufferCount ? 0 : index + 1;
+            }
+        }
+        if (std::fwrite(interleaved.data(), sizeof(float), interleaved.size(), file) != interleaved.size())
+        {
+            return fail();
+        }
+
+        return true;
+    }
+
+    // Writes out what is still buffered and closes the file. Returns false, after reporting it, if that fails,
+    // since the recording is truncated then.
+    bool close()
+    {
+        if (!file)
+        {
+            return true;
+        }
+
+        const bool flushed = std::fflush(file) == 0;
+        const int flushError = errno;
+        const bool closed = std::fclose(file) == 0;
+        file = nullptr;
+
+        if (!flushed || !closed)
+        {
+            std::cerr << "error: cannot write the recording \'" << filePath << "\': " << std::strerror(flushed ? errno : flushError) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+
+    bool fail()
+    {
+        std::cerr << "error: cannot write the recording \'" << filePath << "\': " << std::strerror(errno) << std::endl;
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+
+    std::FILE* file = nullptr;
+    std::string filePath;
+    Clock::time_point startTime;
+    size_t lastReadCount = 0;
+    std::vector<float> interleaved;
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+
+#include <fft.h>
+#include <fft_internal.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+// The muFFT plan flags of a SpectrumAnalyzer and its level calibration (the D-weighted level of
+// a full-scale 1 kHz sine). Without calibrated, SpectrumAnalyzer measures the level itself.
+struct FftPlanSettings
+{
+    unsigned flags = MUFFT_FLAG_CPU_ANY;
+    bool calibrated = false;
+    float zeroLevel = 0.0f;
+};
+
+// A small text file of FftPlanSettings for --fft_cache, so that later starts neither time the
+// plan variants nor run the calibration FFT.
+//
+// An entry is keyed by the FFT size, the input size, the sample rate and the CPU features muFFT
+// dispatches on, one line per entry:
+//   fft_size input_size sample_rate cpu_features flags zero_level
+// The level is written as a hexadecimal float, so it is restored exactly.
+class FftPlanCache
+{
+public:
+
+    struct Key
+    {
+        size_t fftSize = 0;
+        size_t inputSize = 0;
+        int sampleRate = 0;
+        std::string cpuFeatures;
+
+        bool operator==(const Key& other)const
+        {
+            return fftSize == other.fftSize && inputSize == other.inputSize && sampleRate == other.sampleRate && cpuFeatures == other.cpuFeatures;
+        }
+    };
+
+    // the plan flags TunePlanFlags() chooses between
+    static constexpr unsigned PlanFlagCandidates[] = {
+        MUFFT_FLAG_CPU_ANY,
+        MUFFT_FLAG_CPU_NO_AVX,
+        MUFFT_FLAG_CPU_NO_AVX | MUFFT_FLAG_CPU_NO_SSE3,
+        MUFFT_FLAG_CPU_NO_SIMD,
+    };
+
+    // A missing or unreadable file is an empty cache. Lines whose flags are none of the candidates are skipped.
+    explicit FftPlanCache(const std::string& path)
+        : path(path)
+    {
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+
+            std::istringstream is(line);
+            Key key;
+            unsigned flags = 0;
+            std::string level;
+            if (is >> key.fftSize >> key.inputSize >> key.sampleRate >> key.cpuFeatures >> flags >> level
+                && std::find(std::begin(PlanFlagCandidates), std::end(PlanFlagCandidates), flags) != std::end(PlanFlagCandidates))
+            {
+                FftPlanSettings settings;
+                settings.flags = flags;
+                settings.calibrated = true;
+                settings.zeroLevel = std::strtof(level.c_str(), nullptr);
+                entries.emplace_back(key, settings);
+            }
+        }
+    }
+
+    bool find(const Key& key, FftPlanSettings& settings)const
+    {
+        // a later line overrides an earlier one
+        const auto it = std::find_if(entries.rbegin(), entries.rend(), [&](const auto& entry) { return entry.first == key; });
+        if (it == entries.rend())
+        {
+            return false;
+        }
+
+        settings = it->second;
+        return true;
+    }
+
+    // appends the entry to the file; a cache that cannot be written only costs the next start its tuning
+    void insert(const Key& key, const FftPlanSettings& settings)
+    {
+        entries.emplace_back(key, settings);
+
+        const bool created = !std::ifstream(path).good();
+        std::ofstream file(path, std::ios::app);
+        if (!file)
+        {
+            std::cerr << "warning: cannot write the FFT plan cache \'" << path << "\'" << std::endl;
+            return;
+        }
+
+        if (created)
+        {
+            file << "# fft_size input_size sample_rate cpu_features flags zero_level\n";
+        }
+
+        char level[32];
+        std::snprintf(level, sizeof(level), "%a", settings.zeroLevel);
+        file << key.fftSize << ' ' << key.inputSize << ' ' << key.sampleRate << ' ' << key.cpuFeatures << ' ' << settings.flags << ' ' << level << '\n';
+    }
+
+    // the instruction sets muFFT chooses between, e.g. "avx,sse3,sse"
+    static std::string CpuFeatures()
+    {
+        std::string features;
+        const auto add = [&](bool supported, const char* name)
+        {
+            if (supported)
+            {
+                features += features.empty() ? name : std::string(",") + name;
+            }
+        };
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        add((info[2] & (1 << 28)) != 0 && osxsave && (_xgetbv(0) & 0x6) == 0x6, "avx");
+        add((info[2] & (1 << 0)) != 0, "sse3");
+        add((info[3] & (1 << 25)) != 0, "sse");
+#elif defined(__x86_64__) || defined(__i386__)
+        add(__builtin_cpu_supports("avx"), "avx");
+        add(__builtin_cpu_supports("sse3"), "sse3");
+        add(__builtin_cpu_supports("sse"), "sse");
+#endif
+
+        return features.empty() ? std::string("generic") : features;
+    }
+
+    // Times an r2c plan of fftSize for every CPU variant muFFT can be restricted to and returns the
+    // flags of the fastest one. The best of several rounds is taken, so a preemption does not decide it.
+    static unsigned TunePlanFlags(size_t fftSize)
+    {
+        static constexpr int rounds = 3;
+
+        // about a million samples per round, at least a few FFTs
+        const size_t repetitions = std::max<size_t>(4, (size_t(1) << 20) / fftSize);
+
+        auto input = static_cast<float*>(mufft_alloc(fftSize * sizeof(float)));
+        auto output = static_cast<cfloat*>(mufft_alloc(fftSize * sizeof(cfloat)));
+        for (size_t i = 0; i < fftSize; ++i)
+        {
+            input[i] = static_cast<float>(i % 17) - 8.0f;
+        }
+
+        unsigned bestFlags = MUFFT_FLAG_CPU_ANY;
+        auto bestTime = std::chrono::steady_clock::duration::max();
+        for (const unsigned flags : PlanFlagCandidates)
+        {
+            mufft_plan_1d* plan = mufft_create_plan_1d_r2c(fftSize, flags);
+            if (!plan)
+            {
+                continue;
+            }
+
+            mufft_execute_plan_1d(plan, output, input);
+
+            for (int round = 0; round < rounds; ++round)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < repetitions; ++i)
+                {
+                    mufft_execute_plan_1d(plan, output, input);
+                }
+                const auto elapsed = std::chrono::steady_clock::now() - start;
+
+                if (elapsed < bestTime)
+                {
+                    bestTime = elapsed;
+                    bestFlags = flags;
+                }
+            }
+
+            mufft_free_plan_1d(plan);
+        }
+
+        mufft_free(input);
+        mufft_free(output);
+
+        return bestFlags;
+    }
+
+private:
+
+    std::string path;
+    std::vector<std::pair<Key, FftPlanSettings>> entries;
+};
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cmath>
+#include <algorithm>
+
+#include "Renderer.hpp"
+#include "OutputFile.hpp"
+
+// Renderer of one line of Width characters, selected with ANALYZER_FIXED_CONFIG together with FixedSpectrumAnalyzer.
+//
+// The bar heights live in std::arrays and the Gaussian weights are kept for the offsets that can reach a bar,
+// so drawing a frame does not allocate and its loops have constant trip counts. The frames are the ones
+// Renderer draws for a single row of Width characters.
+template<size_t Width>
+class FixedRenderer
+{
+public:
+
+    static_assert(0 < Width, "Width must be positive");
+
+    static constexpr size_t Resolution = Width * 2;
+
+    explicit FixedRenderer(const std::string& lineFeed)
+        : lineFeed(lineFeed)
+    {}
+
+    bool open(const std::string& path)
+    {
+        return output.open(path);
+    }
+
+    void write(const std::string& text)
+    {
+        output.write(text);
+    }
+
+    void setFooter(const std::string& text)
+    {
+        footer = text;
+    }
+
+    template<size_t Bands>
+    void draw(const std::array<float, Bands>& values, int windowSize, float smoothing, bool displayAxis)
+    {
+        static_assert(Resolution <= Bands, "every bar needs at least one band");
+        constexpr size_t unitBarWidth = Bands / Resolution;
+
+        // reserved for the first frame, which every later one fits in
+        if (line.capacity() == 0)
+        {
+            line.reserve(lineFeed.size() + (Width + 2) * 3 + footer.size());
+        }
+
+        line.clear();
+        if (!isFirst)
+        {
+            line += lineFeed;
+        }
+        isFirst = false;
+
+        if (displayAxis)
+        {
+            line += "│";
+        }
+
+        for (size_t barIndex = 0; barIndex < Resolution; ++barIndex)
+        {
+            const float* bar = values.data() + unitBarWidth * barIndex;
+
+            float maxValue = 0.0f;
+            for (size_t i = 0; i < unitBarWidth; ++i)
+            {
+                maxValue = std::max(maxValue, bar[i]);
+            }
+
+            smoothed[barIndex] += (maxValue - smoothed[barIndex]) * smoothing;
+        }
+
+        if (weightWindowSize != windowSize)
+        {
+            updateGaussianWeights(windowSize, 1.0f);
+        }
+
+        // only the taps that land on a bar, in the order Renderer adds them
+        const int centerIndex = windowSize / 2;
+        for (size_t barIndex = 0; barIndex < Resolution; ++barIndex)
+        {
+            const int bar = static_cast<int>(barIndex);
+            const int begin = std::max(0, centerIndex - bar);
+            const int end = std::min(windowSize, centerIndex - bar + static_cast<int>(Resolution));
+
+            float value = 0.0f;
+            for (int i = begin; i < end; ++i)
+            {
+                const int offset = i - centerIndex;
+                value += smoothed[bar + offset] * weights[offset + Resolution - 1];
+            }
+
+            blurred[barIndex] = value;
+        }
+
+        for (size_t charIndex = 0; charIndex < Width; ++charIndex)
+        {
+            Renderer::AppendGlyph(line, blurred[charIndex*2 + 0], blurred[charIndex*2 + 1]);
+        }
+
+        if (displayAxis)
+        {
+            line += "│";
+        }
+
+        line += footer;
+
+        output.write(line);
+    }
+
+private:
+
+    // the weights of Renderer, normalized over the whole window but stored only for |offset| < Resolution
+    void updateGaussianWeights(int windowSize, float variance)
+    {
+        const int centerIndex = windowSize / 2;
+
+        float sum = 0.0f;
+        for (int i = 0; i < windowSize; ++i)
+        {
+            sum += Renderer::GaussianWeight(i - centerIndex, variance);
+        }
+
+        for (int offset = 1 - static_cast<int>(Resolution); offset < static_cast<int>(Resolution); ++offset)
+        {
+            weights[offset + Resolution - 1] = Renderer::GaussianWeight(offset, variance) / sum;
+        }
+
+        weightWindowSize = windowSize;
+    }
+
+    std::array<float, Resolution> smoothed{};
+    std::array<float, Resolution> blurred{};
+    std::array<float, Resolution * 2 - 1> weights{};
+    int weightWindowSize = -1;
+
+    std::string line;
+    std::string footer;
+    std::string lineFeed;
+    bool isFirst = true;
+
+    OutputFile output;
+};
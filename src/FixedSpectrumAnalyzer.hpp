@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include <fft.h>
+#include <fft_internal.h>
+
+#include "BandPlan.hpp"
+#include "WindowFunction.hpp"
+#include "SpectrumKernels.hpp"
+#include "SpectrumAnalyzer.hpp"
+
+// SpectrumAnalyzer for one configuration known at compile time, selected with ANALYZER_FIXED_CONFIG.
+//
+// The buffers are std::arrays of the exact sizes and the window is a constexpr table, so the analyzer
+// never touches the heap after init() and every loop has a constant trip count. The band plan depends on
+// the frequency and level range, which stay runtime options, so it is built into fixed storage instead.
+// Only the view passed to update() is analyzed; there is no STFT and no additional view.
+//
+// The results are those of SpectrumAnalyzer(InputSize, FftSize, samplingFrequency, Window) with
+// FftSize - 1 bands, which is the band count main.cpp draws.
+template<size_t FftSize, size_t InputSize, size_t Bands, WindowType Window = WindowType::Hamming>
+class FixedSpectrumAnalyzer
+{
+public:
+
+    static_assert(FftSize != 0 && (FftSize & (FftSize - 1)) == 0, "FftSize must be a power of two");
+    static_assert(0 < InputSize && InputSize <= FftSize, "InputSize must be in [1, FftSize]");
+    static_assert(0 < Bands, "Bands must be positive");
+
+    static constexpr size_t BinCount = FftSize / 2 + 1;
+
+    // not constexpr, so that a static analyzer is zero-filled in .bss rather than stored in the binary
+    // with the default segments (whose levelScale is not 0)
+    FixedSpectrumAnalyzer() {}
+
+    FixedSpectrumAnalyzer(const FixedSpectrumAnalyzer&) = delete;
+    FixedSpectrumAnalyzer& operator=(const FixedSpectrumAnalyzer&) = delete;
+
+    ~FixedSpectrumAnalyzer()
+    {
+        if (muplan)
+        {
+            mufft_free_plan_1d(muplan);
+        }
+    }
+
+    // muFFT allocates the twiddle factors of the plan here, once
+    void init(int samplingFrequency)
+    {
+        sampleFreq = samplingFrequency;
+        unitFreq = samplingFrequency / static_cast<float>(FftSize);
+        normalizeDb = 10.0f * std::log10(2.0f / FftSize);
+
+        muplan = mufft_create_plan_1d_r2c(FftSize, MUFFT_FLAG_CPU_ANY);
+
+        // also zero-fills input[InputSize, FftSize), which is never written afterwards
+        zeroLevel = SpectrumAnalyzer::ZeroLevel(muplan, input.data(), output.data(), InputSize, FftSize, sampleFreq);
+        built = false;
+    }
+
+    // see SpectrumAnalyzer::update()
+    void update(const std::vector<float>& buffer, size_t headIndex, float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        const size_t startIndex = (headIndex + buffer.size() - InputSize) % buffer.size();
+        copyWindowed(buffer, startIndex);
+
+        mufft_execute_plan_1d(muplan, output.data(), input.data());
+
+        const float bottomLevel = zeroLevel + minLevel;
+        const float topLevel = zeroLevel + maxLevel;
+        if (!built || builtBottomLevel != bottomLevel || builtTopLevel != topLevel || builtFreqMin != freqMin || builtFreqMax != freqMax || builtLogBase != logBase)
+        {
+            buildSegments(bottomLevel, topLevel, freqMin, freqMax, logBase);
+        }
+
+        SpectrumKernels::MagnitudeSquared(output.data(), powers.data(), maxBin);
+
+        BandPlan::ApplySegments(segments.data(), segmentCount, powers.data(), normalizeDb, bottomLevel, invRange, segmentLevels.data(), bands.data());
+    }
+
+    const std::array<float, Bands>& spectrum()const
+    {
+        return bands;
+    }
+
+private:
+
+    // windows InputSize samples of the ring buffer starting at startIndex into the FFT input
+    void copyWindowed(const std::vector<float>& buffer, size_t startIndex)
+    {
+        const size_t firstCount = std::min(InputSize, buffer.size() - startIndex);
+        const float* first = buffer.data() + startIndex;
+        for (size_t i = 0; i < firstCount; ++i)
+        {
+            input[i] = window[i] * first[i];
+        }
+
+        const float* second = buffer.data();
+        for (size_t i = firstCount; i < InputSize; ++i)
+        {
+            input[i] = window[i] * second[i - firstCount];
+        }
+    }
+
+    // a segment covers at least one band, so Bands segments always suffice
+    void buildSegments(float bottomLevel, float topLevel, float freqMin, float freqMax, float logBase)
+    {
+        segmentCount = 0;
+        maxBin = 0;
+        BandPlan::BuildSegments(Bands, BinCount, unitFreq, freqMin, freqMax, logBase, [&](const BandPlan::Segment& segment)
+        {
+            segments[segmentCount++] = segment;
+            maxBin = std::max(maxBin, static_cast<size_t>(segment.binEnd));
+        });
+
+        invRange = 1.0f / (topLevel - bottomLevel);
+        builtBottomLevel = bottomLevel;
+        builtTopLevel = topLevel;
+        builtFreqMin = freqMin;
+        builtFreqMax = freqMax;
+        builtLogBase = logBase;
+        built = true;
+    }
+
+    static constexpr std::array<float, InputSize> window = WindowFunction::Table<Window, InputSize>();
+
+    // muFFT reads and writes with aligned SIMD loads, like the buffers of mufft_alloc()
+    alignas(64) std::array<float, FftSize> input{};
+    alignas(64) std::array<cfloat, FftSize> output{};
+    alignas(64) std::array<float, BinCount> powers{};
+
+    std::array<BandPlan::Segment, Bands> segments{};
+    std::array<float, Bands> segmentLevels{};
+    std::array<float, Bands> bands{};
+    size_t segmentCount = 0;
+    size_t maxBin = 0;
+
+    float builtBottomLevel = 0.0f;
+    float builtTopLevel = 0.0f;
+    float builtFreqMin = 0.0f;
+    float builtFreqMax = 0.0f;
+    float builtLogBase = 0.0f;
+    float invRange = 0.0f;
+    bool built = false;
+
+    float sampleFreq = 0.0f;
+    float unitFreq = 0.0f;
+    float normalizeDb = 0.0f;
+    float zeroLevel = 0.0f;
+    mufft_plan_1d* muplan = nullptr;
+};
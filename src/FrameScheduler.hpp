@@ -0,0 +1,140 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+#include "FrameStats.hpp"
+
+// Decides when the next frame is processed.
+//
+// With hopSize == 0 frames are drawn on a fixed grid of 1/fps seconds. A frame that overruns is
+// followed immediately by the next one; if it overran by more than a whole period, the missed
+// frames are dropped and the grid restarts from now.
+// With hopSize > 0 a frame is processed whenever hopSize new samples have arrived.
+//
+// In both modes nothing is processed while no new samples arrive: the loop blocks in the
+// capturer's waitForSamples() instead of redrawing the same data.
+class FrameScheduler
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    FrameScheduler() = default;
+
+    FrameScheduler(float fps, size_t hopSize, bool realtime)
+        : period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps)))
+        , hopSize(hopSize)
+        , realtime(realtime)
+        , nextFrameTime(Clock::now())
+    {}
+
+    // Blocks until the next frame is due. Returns false when the capturer has been closed or RequestStop() was called.
+    template<class Capturer>
+    bool waitNextFrame(Capturer& capturer)
+    {
+        if (realtime && hopSize == 0)
+        {
+            std::this_thread::sleep_until(nextFrameTime);
+        }
+
+        const size_t targetCount = lastReadCount + std::max<size_t>(1, hopSize);
+
+        // waitForSamples() returns within idleTimeout, so a stop is noticed even without samples
+        while (capturer.isOpen() && !stopRequested)
+        {
+            capturer.waitForSamples(targetCount, Clock::now() + idleTimeout);
+            {
+                ANALYZER_STATS_SCOPE(stats, Stage::Capture);
+                capturer.update();
+            }
+
+            if (targetCount <= capturer.bufferReadCount())
+            {
+                frameStartTime = Clock::now();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void frameDone(size_t readCount)
+    {
+        lastReadCount = readCount;
+
+        // a frame that started late only because no samples arrived restarts the grid
+        if (nextFrameTime + period < frameStartTime)
+        {
+            nextFrameTime = frameStartTime;
+        }
+
+        const auto now = Clock::now();
+        nextFrameTime += period;
+        // only the fixed grid has frames to be late for
+        const bool paced = realtime && hopSize == 0;
+        if (paced && nextFrameTime < now)
+        {
+            ++lateCount;
+        }
+        if (nextFrameTime + period < now)
+        {
+            ++overrunCount;
+            if (paced)
+            {
+                droppedCount += static_cast<size_t>((now - nextFrameTime) / period);
+            }
+            nextFrameTime = now;
+        }
+    }
+
+    size_t overruns()const
+    {
+        return overrunCount;
+    }
+
+    // frames that ended after the next one was due
+    size_t lateFrames()const
+    {
+        return lateCount;
+    }
+
+    // grid slots skipped by the overruns
+    size_t droppedFrames()const
+    {
+        return droppedCount;
+    }
+
+    // Ends the frame loop of every scheduler as if the capturer had been closed, so that the code after it
+    // still finishes the outputs. Safe to call from a signal handler.
+    static void RequestStop()
+    {
+        stopRequested = true;
+    }
+
+    // records the time capturer.update() takes as Stage::Capture, see --stats
+    void setStats(FrameStats* frameStats)
+    {
+        stats = frameStats;
+    }
+
+private:
+
+    static constexpr std::chrono::milliseconds idleTimeout{100};
+
+    static inline std::atomic<bool> stopRequested{false};
+
+    Clock::duration period{};
+    size_t hopSize = 0;
+    bool realtime = true;
+
+    Clock::time_point nextFrameTime;
+    Clock::time_point frameStartTime;
+    size_t lastReadCount = 0;
+    size_t overrunCount = 0;
+    size_t lateCount = 0;
+    size_t droppedCount = 0;
+    FrameStats* stats = nullptr;
+};
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Stages of the frame loop timed by --stats.
+// The ring copy of the latest samples and the window are one pass since they were fused, so they share a stage.
+enum class Stage
+{
+    Capture,    // reading the new samples from the capturer
+    Window,     // copying the latest samples out of the ring buffer through the window
+    Fft,        // the FFT, or the whole update of --engine sdft and multires
+    Bands,      // magnitudes and the band plan
+    Render,     // smoothing, blur and glyphs
+    Output,     // writing and publishing the frame
+    Frame,      // the whole frame, without the wait for samples
+    Count,
+};
+
+// Latency histograms of the stages and the sample backlog, summarized periodically by --stats.
+//
+// The histograms are log-linear, 8 buckets per power of two, so a percentile is accurate to 12.5%.
+// Recording is a relaxed atomic increment, so the analyzers may record from the worker threads.
+class FrameStats
+{
+public:
+
+    using Clock = std::chrono::steady_clock;
+
+    // Writes the summaries to stderr if path is "stderr", otherwise appends them to the file.
+    bool open(const std::string& path, double intervalSeconds)
+    {
+        if (path != "stderr")
+        {
+            file.open(path, std::ios::app);
+            if (!file)
+            {
+                std::cerr << "error: cannot open \'" << path << "\' for --stats." << std::endl;
+                return false;
+            }
+        }
+
+        interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(intervalSeconds));
+        intervalStart = Clock::now();
+        return true;
+    }
+
+    void record(Stage stage, Clock::duration elapsed)
+    {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+        stages[static_cast<size_t>(stage)].add(static_cast<std::uint64_t>(std::max<std::int64_t>(0, ns)));
+    }
+
+    // the samples that arrived since the previous frame
+    void recordBacklog(size_t samples)
+    {
+        backlog.add(samples);
+    }
+
+    // the time from the capture of the newest sample of a frame to its output, and the part of it
+    // the capturer reports for the device
+    void recordLatency(Clock::duration latency, std::chrono::microseconds device)
+    {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+        latencies.add(static_cast<std::uint64_t>(std::max<std::int64_t>(0, us)));
+        deviceLatencies.add(static_cast<std::uint64_t>(std::max<std::int64_t>(0, device.count())));
+    }
+
+    // Call after each frame with the running totals of late and dropped frames.
+    // Prints and restarts the summary once per interval.
+    void frameDone(size_t lateFrames, size_t droppedFrames)
+    {
+        const auto now = Clock::now();
+        if (interval <= now - intervalStart)
+        {
+            report(now, lateFrames, droppedFrames);
+        }
+    }
+
+    // prints what was recorded since the last summary
+    void finish(size_t lateFrames, size_t droppedFrames)
+    {
+        report(Clock::now(), lateFrames, droppedFrames);
+    }
+
+private:
+
+    static constexpr size_t SubBuckets = 8;
+    static constexpr size_t BucketCount = 64 * SubBuckets;
+
+    class Histogram
+    {
+    public:
+
+        void add(std::uint64_t value)
+        {
+            buckets[Bucket(value)].fetch_add(1, std::memory_order_relaxed);
+            count.fetch_add(1, std::memory_order_relaxed);
+
+            std::uint64_t current = maxValue.load(std::memory_order_relaxed);
+            while (current < value && !maxValue.compare_exchange_weak(current, value, std::memory_order_relaxed))
+            {
+            }
+        }
+
+        std::uint64_t size()const
+        {
+            return count.load(std::memory_order_relaxed);
+        }
+
+        std::uint64_t max()const
+        {
+            return maxValue.load(std::memory_order_relaxed);
+        }
+
+        // the upper edge of the bucket that holds the q-quantile, at most the maximum
+        std::uint64_t percentile(double q)const
+        {
+            const std::uint64_t total = size();
+            const std::uint64_t rank = static_cast<std::uint64_t>(q * total + 0.5);
+
+            std::uint64_t seen = 0;
+            for (size_t i = 0; i < BucketCount; ++i)
+            {
+                seen += buckets[i].load(std::memory_order_relaxed);
+                if (rank <= seen && seen != 0)
+                {
+                    return std::min(BucketLimit(i), max());
+                }
+            }
+            return max();
+        }
+
+        void clear()
+        {
+            for (auto& bucket : buckets)
+            {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+            count.store(0, std::memory_order_relaxed);
+            maxValue.store(0, std::memory_order_relaxed);
+        }
+
+    private:
+
+        static size_t Bucket(std::uint64_t value)
+        {
+            if (value < SubBuckets)
+            {
+                return static_cast<size_t>(value);
+            }
+
+            const int exponent = std::bit_width(value) - 1;
+            return (exponent - 2) * SubBuckets + ((value >> (exponent - 3)) & (SubBuckets - 1));
+        }
+
+        // the largest value in bucket
+        static std::uint64_t BucketLimit(size_t bucket)
+        {
+            if (bucket < SubBuckets)
+            {
+                return bucket;
+            }
+
+            const int exponent = static_cast<int>(bucket / SubBuckets) + 2;
+            const std::uint64_t sub = bucket % SubBuckets;
+            return ((SubBuckets + sub + 1) << (exponent - 3)) - 1;
+        }
+
+        std::array<std::atomic<std::uint64_t>, BucketCount> buckets{};
+        std::atomic<std::uint64_t> count{0};
+        std::atomic<std::uint64_t> maxValue{0};
+    };
+
+    void report(Clock::time_point now, size_t lateFrames, size_t droppedFrames)
+    {
+        static constexpr const char* stageNames[] = {"capture", "window", "fft", "bands", "render", "output", "frame"};
+
+        std::ostream& out = file.is_open() ? static_cast<std::ostream&>(file) : std::cerr;
+
+        const std::chrono::duration<double> elapsed = now - intervalStart;
+        char line[160];
+
+        std::snprintf(line, sizeof(line), "stats: %llu frames in %.2f s, %zu late, %zu dropped, backlog p50/p99/max %llu/%llu/%llu samples\n",
+            static_cast<unsigned long long>(stage(Stage::Frame).size()), elapsed.count(), lateFrames - lastLateFrames, droppedFrames - lastDroppedFrames,
+            static_cast<unsigned long long>(backlog.percentile(0.5)), static_cast<unsigned long long>(backlog.percentile(0.99)), static_cast<unsigned long long>(backlog.max()));
+        out << line;
+
+        if (latencies.size() != 0)
+        {
+            std::snprintf(line, sizeof(line), "  latency p50/p99/max %.1f/%.1f/%.1f ms from capture to output, of which %.1f ms in the device\n",
+                latencies.percentile(0.5) * 1.0e-3, latencies.percentile(0.99) * 1.0e-3, latencies.max() * 1.0e-3, deviceLatencies.percentile(0.5) * 1.0e-3);
+            out << line;
+        }
+
+        std::snprintf(line, sizeof(line), "  %-8s %10s %10s %10s %10s\n", "[us]", "count", "p50", "p99", "max");
+        out << line;
+
+        for (size_t i = 0; i < static_cast<size_t>(Stage::Count); ++i)
+        {
+            const Histogram& histogram = stages[i];
+            if (histogram.size() == 0)
+            {
+                continue;
+            }
+
+            std::snprintf(line, sizeof(line), "  %-8s %10llu %10.1f %10.1f %10.1f\n", stageNames[i], static_cast<unsigned long long>(histogram.size()),
+                histogram.percentile(0.5) * 1.0e-3, histogram.percentile(0.99) * 1.0e-3, histogram.max() * 1.0e-3);
+            out << line;
+        }
+
+        out << std::flush;
+
+        for (auto& histogram : stages)
+        {
+            histogram.clear();
+        }
+        backlog.clear();
+        latencies.clear();
+        deviceLatencies.clear();
+
+        lastLateFrames = lateFrames;
+        lastDroppedFrames = droppedFrames;
+        intervalStart = now;
+    }
+
+    const Histogram& stage(Stage stage)const
+    {
+        return stages[static_cast<size_t>(stage)];
+    }
+
+    std::array<Histogram, static_cast<size_t>(Stage::Count)> stages;
+    Histogram backlog;
+
+    // in microseconds
+    Histogram latencies;
+    Histogram deviceLatencies;
+
+    std::ofstream file;
+    Clock::duration interval{};
+    Clock::time_point intervalStart;
+    size_t lastLateFrames = 0;
+    size_t lastDroppedFrames = 0;
+};
+
+// Times the rest of the enclosing scope as stage, if stats is not null.
+class StageTimer
+{
+public:
+
+    StageTimer(FrameStats* stats, Stage stage)
+        : stats(stats)
+        , stage(stage)
+    {
+        if (stats)
+        {
+            start = FrameStats::Clock::now();
+        }
+    }
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+
+    ~StageTimer()
+    {
+        if (stats)
+        {
+            stats->record(stage, FrameStats::Clock::now() - start);
+        }
+    }
+
+private:
+
+    FrameStats* stats;
+    Stage stage;
+    FrameStats::Clock::time_point start;
+};
+
+// The timers are only compiled in with ANALYZER_STATS (the CMake option of the same name);
+// without it ANALYZER_STATS_SCOPE expands to nothing and --stats is rejected.
+#ifdef ANALYZER_STATS
+#define ANALYZER_STATS_CONCAT_(a, b) a##b
+#define ANALYZER_STATS_CONCAT(a, b) ANALYZER_STATS_CONCAT_(a, b)
+#define ANALYZER_STATS_SCOPE(stats, stage) StageTimer ANALYZER_STATS_CONCAT(stageTimer, __LINE__)((stats), (stage))
+#else
+#define ANALYZER_STATS_SCOPE(stats, stage) ((void)0)
+#endif
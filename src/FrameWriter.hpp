@@ -0,0 +1,146 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include "OutputFile.hpp"
+
+enum class BinaryFormat
+{
+    F32,
+    U8,
+};
+
+// Serializes the spectra into binary frames for programs that read the values directly.
+//
+// Every frame is a FrameHeader followed by rowCount * bandCount values, row after row, in the
+// byte order of the host (little endian on x86 and ARM). With BinaryFormat::F32 the values of
+// SpectrumAnalyzer::spectrum() are written as they are (0 is the bottom dB of the display, 1 the top);
+// with BinaryFormat::U8 they are clamped to [0, 1] and scaled to 0-255.
+// The frame size only changes if the band count does, so consumers can read fixed-size records.
+class FrameEncoder
+{
+public:
+
+    struct FrameHeader
+    {
+        char magic[4];              // "MSAF"
+        std::uint32_t headerSize;   // sizeof(FrameHeader), the offset of the values
+        std::uint64_t sequence;     // 0 for the first frame
+        std::uint64_t timestampNs;  // system clock, nanoseconds since the UNIX epoch
+        std::uint32_t sampleRate;
+        std::uint32_t bandCount;
+        std::uint32_t rowCount;     // channels when stacked, otherwise 1
+        std::uint32_t valueFormat;  // 0: float32, 1: uint8
+    };
+
+    static_assert(sizeof(FrameHeader) == 40, "FrameHeader must not contain padding");
+
+    FrameEncoder(BinaryFormat format, int samplingFrequency)
+        : format(format)
+        , sampleRate(samplingFrequency)
+    {}
+
+    // Builds the next frame in a reused buffer.
+    const std::vector<std::uint8_t>& encode(const std::vector<float>* const* rows, size_t rowCount)
+    {
+        const size_t bandCount = rows[0]->size();
+        const size_t valueBytes = format == BinaryFormat::F32 ? sizeof(float) : sizeof(std::uint8_t);
+
+        frame.resize(sizeof(FrameHeader) + rowCount * bandCount * valueBytes);
+
+        FrameHeader header;
+        std::memcpy(header.magic, "MSAF", 4);
+        header.headerSize = sizeof(FrameHeader);
+        header.sequence = sequence++;
+        header.timestampNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        header.sampleRate = static_cast<std::uint32_t>(sampleRate);
+        header.bandCount = static_cast<std::uint32_t>(bandCount);
+        header.rowCount = static_cast<std::uint32_t>(rowCount);
+        header.valueFormat = format == BinaryFormat::F32 ? 0 : 1;
+        std::memcpy(frame.data(), &header, sizeof(header));
+
+        std::uint8_t* dst = frame.data() + sizeof(FrameHeader);
+        for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+        {
+            const std::vector<float>& values = *rows[rowIndex];
+
+            if (format == BinaryFormat::F32)
+            {
+                std::memcpy(dst, values.data(), bandCount * sizeof(float));
+            }
+            else
+            {
+                for (size_t i = 0; i < bandCount; ++i)
+                {
+                    dst[i] = static_cast<std::uint8_t>(std::min(1.0f, std::max(0.0f, values[i])) * 255.0f + 0.5f);
+                }
+            }
+
+            dst += bandCount * valueBytes;
+        }
+
+        return frame;
+    }
+
+    const std::vector<std::uint8_t>& encode(const std::vector<const std::vector<float>*>& rows)
+    {
+        return encode(rows.data(), rows.size());
+    }
+
+private:
+
+    BinaryFormat format = BinaryFormat::F32;
+    int sampleRate = 0;
+    std::uint64_t sequence = 0;
+    std::vector<std::uint8_t> frame;
+};
+
+// Writes the binary frames of FrameEncoder to stdout or a file.
+class FrameWriter
+{
+public:
+
+    FrameWriter(BinaryFormat format, int samplingFrequency)
+        : encoder(format, samplingFrequency)
+    {
+        output.setBinary();
+    }
+
+    bool open(const std::string& path)
+    {
+        if (!output.open(path))
+        {
+            return false;
+        }
+
+        output.setBinary();
+        return true;
+    }
+
+    void write(const std::vector<float>& values)
+    {
+        const std::vector<float>* row = &values;
+        writeFrame(encoder.encode(&row, 1));
+    }
+
+    void write(const std::vector<const std::vector<float>*>& rows)
+    {
+        writeFrame(encoder.encode(rows));
+    }
+
+private:
+
+    void writeFrame(const std::vector<std::uint8_t>& frame)
+    {
+        output.write(frame.data(), frame.size());
+    }
+
+    FrameEncoder encoder;
+    OutputFile output;
+};
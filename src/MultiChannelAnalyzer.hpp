@@ -0,0 +1,198 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <algorithm>
+
+#include "SpectrumAnalyzer.hpp"
+#include "WorkerPool.hpp"
+
+enum class ChannelMode
+{
+    First,
+    Stack,
+    Max,
+    Mean,
+    MidSide,
+};
+
+// Runs one SpectrumAnalyzer per channel (or on the mid and side signals of a stereo pair)
+// in parallel on a worker pool, and provides the spectra to draw: one line per analyzer
+// when stacked, or their element-wise max or mean as a single line.
+class MultiChannelAnalyzer
+{
+public:
+
+    MultiChannelAnalyzer(ChannelMode mode, size_t channelCount, size_t inputSampleSize, size_t fftSampleSize, int samplingFrequency, WindowType windowType,
+        const FftPlanSettings& settings = FftPlanSettings())
+        : mode(mode)
+        , pool(std::min<size_t>(AnalyzerCount(mode, channelCount), std::max(1u, std::thread::hardware_concurrency())) - 1)
+    {
+        // the analyzers share one configuration, so the first one calibrates for all of them
+        analyzers.resize(AnalyzerCount(mode, channelCount));
+        for (auto& analyzer : analyzers)
+        {
+            analyzer = std::make_unique<SpectrumAnalyzer>(inputSampleSize, fftSampleSize, samplingFrequency, windowType,
+                &analyzer == &analyzers.front() ? settings : analyzers.front()->fftPlanSettings());
+        }
+
+        if (mode == ChannelMode::MidSide)
+        {
+            midSide.resize(2);
+        }
+
+        buildRows();
+    }
+
+    // adds a view with other display parameters to every analyzer, see SpectrumAnalyzer::addView()
+    size_t addView(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        size_t view = 0;
+        for (auto& analyzer : analyzers)
+        {
+            view = analyzer->addView(minLevel, maxLevel, freqMin, freqMax, logBase);
+        }
+
+        buildRows();
+
+        return view;
+    }
+
+    template<class Capturer>
+    void update(const Capturer& capturer, float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        const size_t headIndex = capturer.bufferHeadIndex();
+
+        if (mode == ChannelMode::MidSide)
+        {
+            pool.run(2, [&](size_t index)
+            {
+                const auto& left = capturer.getBuffer(0);
+                const auto& right = capturer.getBuffer(1);
+                const float sign = index == 0 ? 1.0f : -1.0f;
+
+                auto& signal = midSide[index];
+                signal.resize(left.size());
+                for (size_t i = 0; i < signal.size(); ++i)
+                {
+                    signal[i] = 0.5f * (left[i] + sign * right[i]);
+                }
+
+                analyzers[index]->update(signal, headIndex, minLevel, maxLevel, freqMin, freqMax, logBase);
+            });
+        }
+        else
+        {
+            pool.run(analyzers.size(), [&](size_t index)
+            {
+                analyzers[index]->update(capturer.getBuffer(index), headIndex, minLevel, maxLevel, freqMin, freqMax, logBase);
+            });
+        }
+
+        if (mode == ChannelMode::Max || mode == ChannelMode::Mean)
+        {
+            for (size_t view = 0; view < combined.size(); ++view)
+            {
+                combine(view);
+            }
+        }
+    }
+
+    // see SpectrumAnalyzer::setStats(), every analyzer records into the same stats
+    void setStats(FrameStats* stats)
+    {
+        for (auto& analyzer : analyzers)
+        {
+            analyzer->setStats(stats);
+        }
+    }
+
+    // the lines to draw for a view, valid until the next addView()
+    const std::vector<const std::vector<float>*>& spectra(size_t view = 0)const
+    {
+        return rows[view];
+    }
+
+    // the analyzer of the first channel (or of the mid signal)
+    SpectrumAnalyzer& primary()
+    {
+        return *analyzers[0];
+    }
+
+    size_t threadCount()const
+    {
+        return pool.concurrency();
+    }
+
+    static size_t AnalyzerCount(ChannelMode mode, size_t channelCount)
+    {
+        switch (mode)
+        {
+        case ChannelMode::First:   return 1;
+        case ChannelMode::MidSide: return 2;
+        default:                   return channelCount;
+        }
+    }
+
+private:
+
+    void buildRows()
+    {
+        const size_t viewCount = analyzers[0]->viewCount();
+
+        rows.assign(viewCount, {});
+        if (mode == ChannelMode::Max || mode == ChannelMode::Mean)
+        {
+            combined.resize(viewCount);
+        }
+
+        for (size_t view = 0; view < viewCount; ++view)
+        {
+            if (mode == ChannelMode::Max || mode == ChannelMode::Mean)
+            {
+                rows[view].push_back(&combined[view]);
+            }
+            else
+            {
+                for (const auto& analyzer : analyzers)
+                {
+                    rows[view].push_back(&analyzer->spectrum(view));
+                }
+            }
+        }
+    }
+
+    void combine(size_t view)
+    {
+        auto& result = combined[view];
+
+        const auto& first = analyzers[0]->spectrum(view);
+        result.assign(first.begin(), first.end());
+
+        for (size_t a = 1; a < analyzers.size(); ++a)
+        {
+            const auto& spectrum = analyzers[a]->spectrum(view);
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                result[i] = mode == ChannelMode::Max ? std::max(result[i], spectrum[i]) : result[i] + spectrum[i];
+            }
+        }
+
+        if (mode == ChannelMode::Mean)
+        {
+            const float scale = 1.0f / analyzers.size();
+            for (auto& value : result)
+            {
+                value *= scale;
+            }
+        }
+    }
+
+    ChannelMode mode = ChannelMode::First;
+    WorkerPool pool;
+    std::vector<std::unique_ptr<SpectrumAnalyzer>> analyzers;
+    std::vector<std::vector<float>> midSide;
+    std::vector<std::vector<float>> combined;
+    std::vector<std::vector<const std::vector<float>*>> rows;
+};
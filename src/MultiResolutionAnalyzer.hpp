@@ -0,0 +1,373 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <fft.h>
+#include <fft_internal.h>
+
+#include "BandPlan.hpp"
+#include "WindowFunction.hpp"
+#include "SpectrumKernels.hpp"
+
+// Analyzes the log-frequency axis octave by octave instead of with one FFT sized for the lowest band.
+//
+// The signal is decimated level after level by half-band low-pass filters, and every level runs the
+// same small FFT of octaveFftSize samples on its latest samples. Level k, at samplingFrequency / 2^k,
+// covers the frequencies in (rate / 8, rate / 4], except that level 0 reaches up to the Nyquist
+// frequency and the last level down to 0 Hz. The lowest level resolves as finely as an FFT of
+// octaveFftSize * 2^(levelCount - 1) samples, while the high bands only span octaveFftSize samples.
+//
+// Like SlidingDftAnalyzer, the decimation consumes every sample read since the previous update.
+// spectrum() follows SpectrumAnalyzer::spectrum(), each band being read from the level its lower edge belongs to.
+class MultiResolutionAnalyzer
+{
+public:
+
+    MultiResolutionAnalyzer(size_t octaveFftSize, size_t levelCount, size_t bandCount, int samplingFrequency, WindowType windowType)
+        : fftSize(octaveFftSize)
+        , bandCount(bandCount)
+        , sampleFreq(samplingFrequency)
+        , taps(HalfBandTaps())
+    {
+        input = static_cast<float*>(mufft_alloc(fftSize * sizeof(float)));
+        output = static_cast<cfloat*>(mufft_alloc(fftSize * sizeof(cfloat)));
+        window = static_cast<float*>(mufft_alloc(fftSize * sizeof(float)));
+        muplan = mufft_create_plan_1d_r2c(fftSize, MUFFT_FLAG_CPU_ANY);
+
+        WindowFunction::Fill(windowType, window, fftSize);
+
+        levels.resize(std::max<size_t>(1, levelCount));
+        for (auto& level : levels)
+        {
+            level.history.assign(fftSize, 0.0f);
+            level.delay.assign(taps.size() * 2, 0.0f);
+            level.powers.resize(binCount());
+        }
+
+        // a full-scale sine at 1 kHz through a rectangular window, the same reference as SpectrumAnalyzer
+        zeroLevel = 10.0f * std::log10(BandPlan::DWeighting(1000.0f));
+    }
+
+    MultiResolutionAnalyzer(const MultiResolutionAnalyzer&) = delete;
+    MultiResolutionAnalyzer& operator=(const MultiResolutionAnalyzer&) = delete;
+
+    ~MultiResolutionAnalyzer()
+    {
+        mufft_free(input);
+        mufft_free(output);
+        mufft_free(window);
+        mufft_free_plan_1d(muplan);
+    }
+
+    // Feeds the samples read since the previous call, readCount being the total number of samples
+    // read by the capturer, and updates the spectrum of every view.
+    // If more samples arrived than buffer holds, the levels go on with the latest samples it still holds.
+    void update(const std::vector<float>& buffer, size_t headIndex, size_t readCount, float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        size_t newCount = readCount - lastReadCount;
+        if (readCount < lastReadCount)
+        {
+            // the capturer started over
+            reset();
+            newCount = readCount;
+        }
+        newCount = std::min(newCount, buffer.size());
+        lastReadCount = readCount;
+
+        // the latest newCount samples, in up to two contiguous spans
+        const size_t bufferCount = buffer.size();
+        const size_t startIndex = (headIndex + bufferCount - newCount) % std::max<size_t>(1, bufferCount);
+        const size_t firstCount = std::min(newCount, bufferCount - startIndex);
+        feed(buffer.data() + startIndex, firstCount);
+        feed(buffer.data(), newCount - firstCount);
+
+        for (auto& level : levels)
+        {
+            executeFFT(level);
+        }
+
+        mainView.minLevel = minLevel;
+        mainView.maxLevel = maxLevel;
+        mainView.freqMin = freqMin;
+        mainView.freqMax = freqMax;
+        mainView.logBase = logBase;
+        applyView(mainView);
+
+        for (auto& view : views)
+        {
+            applyView(view);
+        }
+    }
+
+    // see SpectrumAnalyzer::addView()
+    size_t addView(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        views.push_back(View{minLevel, maxLevel, freqMin, freqMax, logBase});
+        return views.size();
+    }
+
+    const std::vector<float>& spectrum(size_t view = 0)const
+    {
+        return view == 0 ? mainView.spectrum : views[view - 1].spectrum;
+    }
+
+    size_t viewCount()const
+    {
+        return views.size() + 1;
+    }
+
+    size_t levelCount()const
+    {
+        return levels.size();
+    }
+
+private:
+
+    struct Level
+    {
+        // the latest fftSize samples at the rate of this level, circular
+        std::vector<float> history;
+        size_t historyIndex = 0;
+
+        // the input of the filter to the next level, stored twice so that it is read contiguously
+        std::vector<float> delay;
+        size_t delayIndex = 0;
+        bool odd = false;
+
+        std::vector<float> powers;
+    };
+
+    struct LevelBands
+    {
+        size_t bandBegin = 0;
+        size_t bandEnd = 0;
+        BandPlan plan;
+    };
+
+    struct View
+    {
+        float minLevel = 0.0f;
+        float maxLevel = 0.0f;
+        float freqMin = 0.0f;
+        float freqMax = 0.0f;
+        float logBase = 0.0f;
+
+        // the bands each level fills, for the parameters below
+        std::vector<LevelBands> levels;
+        float builtMinLevel = 0.0f;
+        float builtMaxLevel = 0.0f;
+        float builtFreqMin = 0.0f;
+        float builtFreqMax = 0.0f;
+        float builtLogBase = 0.0f;
+
+        std::vector<float> spectrum;
+    };
+
+    // windowed-sinc low-pass at a quarter of the rate: flat up to rate / 8, the top of the next level,
+    // and more than 70 dB down from 3 / 8 of the rate, the lowest frequency that aliases into it
+    static std::vector<float> HalfBandTaps()
+    {
+        const int tapCount = 23;
+        const double pi = 3.14159265358979323846;
+
+        std::vector<float> result(tapCount);
+        double sum = 0.0;
+        for (int i = 0; i < tapCount; ++i)
+        {
+            const double n = i - (tapCount - 1) / 2.0;
+            const double sinc = n == 0.0 ? 0.5 : std::sin(0.5 * pi * n) / (pi * n);
+            const double blackman = 0.42 - 0.5 * std::cos(2.0 * pi * i / (tapCount - 1)) + 0.08 * std::cos(4.0 * pi * i / (tapCount - 1));
+            result[i] = static_cast<float>(sinc * blackman);
+            sum += result[i];
+        }
+
+        for (auto& tap : result)
+        {
+            tap = static_cast<float>(tap / sum);
+        }
+
+        return result;
+    }
+
+    size_t binCount()const
+    {
+        return fftSize / 2 + 1;
+    }
+
+    // the FFT normalization 2/fftSize, in dB of magnitude
+    float normalizeDb()const
+    {
+        return 10.0f * std::log10(2.0f / fftSize);
+    }
+
+    float levelRate(size_t level)const
+    {
+        return sampleFreq / static_cast<float>(size_t(1) << level);
+    }
+
+    void reset()
+    {
+        for (auto& level : levels)
+        {
+            std::fill(level.history.begin(), level.history.end(), 0.0f);
+            std::fill(level.delay.begin(), level.delay.end(), 0.0f);
+            level.historyIndex = 0;
+            level.delayIndex = 0;
+            level.odd = false;
+        }
+    }
+
+    void feed(const float* samples, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            push(samples[i]);
+        }
+    }
+
+    // stores a sample in level 0 and passes every other filtered sample on to the next level
+    void push(float x)
+    {
+        const size_t tapCount = taps.size();
+
+        for (size_t index = 0;; ++index)
+        {
+            Level& level = levels[index];
+            level.history[level.historyIndex] = x;
+            level.historyIndex = (level.historyIndex + 1) & (fftSize - 1);
+
+            if (index + 1 == levels.size())
+            {
+                return;
+            }
+
+            level.delay[level.delayIndex] = x;
+            level.delay[level.delayIndex + tapCount] = x;
+            level.delayIndex = level.delayIndex + 1 == tapCount ? 0 : level.delayIndex + 1;
+
+            level.odd = !level.odd;
+            if (level.odd)
+            {
+                return;
+            }
+
+            // oldest first
+            const float* delay = level.delay.data() + level.delayIndex;
+            float y = 0.0f;
+            for (size_t i = 0; i < tapCount; ++i)
+            {
+                y += taps[i] * delay[i];
+            }
+            x = y;
+        }
+    }
+
+    void executeFFT(Level& level)
+    {
+        // the history starts at historyIndex, oldest first
+        const size_t firstCount = fftSize - level.historyIndex;
+        const float* first = level.history.data() + level.historyIndex;
+        for (size_t i = 0; i < firstCount; ++i)
+        {
+            input[i] = window[i] * first[i];
+        }
+
+        const float* second = level.history.data();
+        for (size_t i = firstCount; i < fftSize; ++i)
+        {
+            input[i] = window[i] * second[i - firstCount];
+        }
+
+        mufft_execute_plan_1d(muplan, output, input);
+
+        SpectrumKernels::MagnitudeSquared(output, level.powers.data(), binCount());
+    }
+
+    void applyView(View& view)
+    {
+        if (view.levels.empty() || view.builtMinLevel != view.minLevel || view.builtMaxLevel != view.maxLevel
+            || view.builtFreqMin != view.freqMin || view.builtFreqMax != view.freqMax || view.builtLogBase != view.logBase)
+        {
+            buildView(view);
+        }
+
+        view.spectrum.resize(bandCount);
+        for (size_t index = 0; index < levels.size(); ++index)
+        {
+            auto& bands = view.levels[index];
+            if (bands.bandBegin == bands.bandEnd)
+            {
+                continue;
+            }
+
+            bands.plan.apply(levels[index].powers.data(), normalizeDb(), bandValues);
+            std::copy(bandValues.begin(), bandValues.end(), view.spectrum.begin() + bands.bandBegin);
+        }
+    }
+
+    // splits the bands of the view between the levels, from the lowest frequencies up
+    void buildView(View& view)const
+    {
+        const float logFreqMin = std::pow(view.freqMin, 1.0f / view.logBase);
+        const float logFreqMax = std::pow(view.freqMax, 1.0f / view.logBase);
+        const auto bandFreq = [&](size_t band)
+        {
+            const float t = 1.0f * band / bandCount;
+            return std::pow(logFreqMin + (logFreqMax - logFreqMin) * t, view.logBase);
+        };
+
+        const float bottomLevel = zeroLevel + view.minLevel;
+        const float topLevel = zeroLevel + view.maxLevel;
+
+        view.levels.assign(levels.size(), {});
+
+        size_t bandBegin = 0;
+        for (size_t index = levels.size(); index-- > 0;)
+        {
+            const float upperFreq = index == 0 ? std::numeric_limits<float>::infinity() : levelRate(index) / 4.0f;
+
+            size_t bandEnd = bandBegin;
+            while (bandEnd < bandCount && bandFreq(bandEnd) <= upperFreq)
+            {
+                ++bandEnd;
+            }
+
+            auto& bands = view.levels[index];
+            bands.bandBegin = bandBegin;
+            bands.bandEnd = bandEnd;
+            if (bandBegin != bandEnd)
+            {
+                bands.plan.build(bandEnd - bandBegin, binCount(), levelRate(index) / fftSize, bandFreq(bandBegin), bandFreq(bandEnd), view.logBase, bottomLevel, topLevel);
+            }
+
+            bandBegin = bandEnd;
+        }
+
+        view.builtMinLevel = view.minLevel;
+        view.builtMaxLevel = view.maxLevel;
+        view.builtFreqMin = view.freqMin;
+        view.builtFreqMax = view.freqMax;
+        view.builtLogBase = view.logBase;
+    }
+
+    size_t fftSize = 0;
+    size_t bandCount = 0;
+    float sampleFreq = 0.0f;
+    float zeroLevel = 0.0f;
+
+    std::vector<float> taps;
+    std::vector<Level> levels;
+    size_t lastReadCount = 0;
+
+    View mainView;
+    std::vector<View> views;
+    std::vector<float> bandValues;
+
+    float* input = nullptr;
+    float* window = nullptr;
+    cfloat* output = nullptr;
+    mufft_plan_1d* muplan = nullptr;
+};
@@ -1,9 +1,67 @@
 #include <map>
 #include <vector>
 #include <string>
+#include <sstream>
 
 #include <cxxopts.hpp>
 
+#include "WindowFunction.hpp"
+#include "SoundCapturerStream.hpp"
+#include "SoundCapturerGenerator.hpp"
+#include "MultiChannelAnalyzer.hpp"
+#include "FrameWriter.hpp"
+#include "Renderer.hpp"
+
+enum class CaptureSource
+{
+    Device,
+    Stdin,
+    Replay,
+    Generator,
+};
+
+enum class OutputFormat
+{
+    Text,
+    Binary,
+    None,
+};
+
+enum class AnalyzerEngine
+{
+    Fft,
+    SlidingDft,
+    MultiResolution,
+};
+
+enum class StftMode
+{
+    Off,
+    Each,
+    Max,
+    Mean,
+};
+
+// Display parameters of one output. Several profiles share one capture and one FFT.
+struct OutputProfile
+{
+    int characterSize = 0;
+    float bottomLevel = 0;
+    float topLevel = 0;
+    float minFreq = 0;
+    float maxFreq = 0;
+    float axisLogBase = 0;
+    int windowSize = 0;
+    float smoothing = 0;
+    bool displayAxis = false;
+    std::string lineFeed;
+    RenderMode renderMode = RenderMode::Line;
+    int rows = 1;
+
+    // stdout if empty
+    std::string outputPath;
+};
+
 class Option
 {
 public:
@@ -25,11 +83,40 @@ public:
                 ("u,upper_freq", "maximum cutoff frequency(Hz).", cxxopts::value<float>()->default_value("5000"), "x")
                 ("f,fft_size", "FFT sample size. N must be power of two.", cxxopts::value<int>()->default_value("8192"), "N")
                 ("i,input_size", "N <= fft_size is input sample size.", cxxopts::value<int>()->default_value("2048"), "N")
+                ("w,window", "window function applied to the input samples.", cxxopts::value<std::string>()->default_value("hamming"), "{\'hamming\'|\'hann\'|\'blackman_harris\'|\'kaiser\'|\'flat_top\'}")
                 ("g,gaussian_diameter", "display each spectrum bar with a Gaussian blur with the surrounding N bars.", cxxopts::value<int>()->default_value("1"), "N")
                 ("s,smoothing", "x in (0.0, 1.0] is linear interpolation parameter for the previous frame. if 1.0, always display the latest value.", cxxopts::value<float>()->default_value("0.5"), "x")
                 ("a,axis", "display axis if 'on'.", cxxopts::value<std::string>()->default_value("on"), "{\'on\'|\'off\'}")
                 ("axis_log_base", "logarithm base of the horizontal axis.", cxxopts::value<float>()->default_value("10"), "x")
                 ("line_feed", "line feed character.", cxxopts::value<std::string>()->default_value("CR"), "{\'CR\'|\'LF\'|\'CRLF\'}")
+                ("display", "draw each spectrum as one 'line', as 'bars' --rows lines high, or as a 'waterfall' of the latest --rows frames. bars and waterfall are drawn on a terminal and only rewrite the characters that changed.", cxxopts::value<std::string>()->default_value("line"), "{\'line\'|\'bars\'|\'waterfall\'}")
+                ("rows", "height in lines of --display bars and waterfall.", cxxopts::value<int>()->default_value("8"), "N")
+                ("output", "draw the spectrum as 'text', write 'binary' frames of the band values for other programs, or write 'none' (e.g. with --shm).", cxxopts::value<std::string>()->default_value("text"), "{\'text\'|\'binary\'|\'none\'}")
+                ("binary_format", "value type of the binary frames: float32, or 0-255 quantized.", cxxopts::value<std::string>()->default_value("f32"), "{\'f32\'|\'u8\'}")
+                ("shm", "publish the latest spectrum of the first profile, and its text if drawn, in the POSIX shared memory NAME (e.g. /analyzer). see SharedSpectrum.hpp for readers.", cxxopts::value<std::string>()->default_value(""), "NAME")
+                ("serve", "listen on the Unix domain socket PATH and push the binary frames (see --binary_format) of the first profile to every client. slow clients skip frames.", cxxopts::value<std::string>()->default_value(""), "PATH")
+                ("stats", "print the time each stage of the frame takes (p50/p99/max), the late and dropped frames and the sample backlog to stderr, or with --stats=PATH append them to the file PATH (the = is required).", cxxopts::value<std::string>()->default_value("")->implicit_value("stderr"), "PATH")
+                ("stats_interval", "seconds between the summaries of --stats.", cxxopts::value<float>()->default_value("5"), "x")
+                ("low_latency", "if 'on', minimize the time from sound to display: small capture fragments, and each frame drawn as soon as its samples (see --hop) arrive instead of on the --fps clock. see --stats for the measured latency.", cxxopts::value<std::string>()->default_value("off"), "{\'on\'|\'off\'}")
+                ("source", "capture from the default audio device, read PCM from stdin, play back the --replay recording, or generate the --signal.", cxxopts::value<std::string>()->default_value("device"), "{\'device\'|\'stdin\'|\'replay\'|\'generator\'}")
+                ("signal", "signal of the generator source: a logarithmic sine 'sweep' over 10 s, a 'multitone' of sines two octaves apart from 62.5 Hz, 'white' or 'pink' noise, or 'silence'.", cxxopts::value<std::string>()->default_value("sweep"), "{\'sweep\'|\'multitone\'|\'white\'|\'pink\'|\'silence\'}")
+                ("signal_speed", "speed of the generator source relative to realtime, e.g. 4 generates 4 seconds of signal per second.", cxxopts::value<float>()->default_value("1"), "x")
+                ("signal_duration", "seconds of signal the generator source generates before it ends, 0 for no end.", cxxopts::value<float>()->default_value("0"), "x")
+                ("record", "write the samples every frame analyzes, with their capture times, to the file PATH for --source replay.", cxxopts::value<std::string>()->default_value(""), "PATH")
+                ("replay", "the recording of --record that --source replay plays back. with the options of the recording, it draws the same frames.", cxxopts::value<std::string>()->default_value(""), "PATH")
+                ("format", "sample format of the stdin source. 'wav' takes format, channels and rate from the header.", cxxopts::value<std::string>()->default_value("s16le"), "{\'s16le\'|\'f32le\'|\'wav\'}")
+                ("channels", "number of channels to capture, of interleaved channels of the stdin source, or to generate.", cxxopts::value<int>()->default_value("2"), "N")
+                ("channel_mode", "analyze the 'first' channel only, or every channel and draw them as 'stack'ed lines or as their 'max' or 'mean'. 'mid_side' draws the mid and side signals of the first two channels.", cxxopts::value<std::string>()->default_value("first"), "{\'first\'|\'stack\'|\'max\'|\'mean\'|\'mid_side\'}")
+                ("sample_rate", "sampling frequency(Hz). 0 captures at the native rate of the device, so that the sound server does not resample, and reads or generates the other sources at 48000.", cxxopts::value<int>()->default_value("0"), "N")
+                ("realtime", "if 'off', process the stdin, replay or generator source as fast as possible instead of pacing the frames.", cxxopts::value<std::string>()->default_value("on"), "{\'on\'|\'off\'}")
+                ("fps", "maximum number of frames drawn per second.", cxxopts::value<float>()->default_value("60"), "x")
+                ("hop", "if N > 0, process a frame on every N new samples instead of at a fixed frame rate. with --stft, the STFT hop size (default input_size/4).", cxxopts::value<int>()->default_value("0"), "N")
+                ("profile", "add an output profile, e.g. 'chars=64:lower_freq=20:output=spectrum.txt'. keys are chars, top_db, bottom_db, lower_freq, upper_freq, axis_log_base, gaussian_diameter, smoothing, axis, line_feed, display, rows and output, which must come last. unset keys take the values of the options above. all profiles share one capture and one FFT, and at most one may write to stdout.", cxxopts::value<std::vector<std::string>>(), "PROFILE")
+                ("engine", "compute the whole spectrum with an 'fft' every frame, only the --track_freqs with a sliding DFT ('sdft') updated on every sample, or octave by octave with a small FFT per octave ('multires'). the sliding DFT uses a Hann window of input_size samples.", cxxopts::value<std::string>()->default_value("fft"), "{\'fft\'|\'sdft\'|\'multires\'}")
+                ("octave_fft_size", "FFT sample size of each octave of --engine multires. octaves are added until the lowest one resolves as finely as fft_size.", cxxopts::value<int>()->default_value("1024"), "N")
+                ("track_freqs", "comma-separated frequencies(Hz) tracked by --engine sdft, e.g. 50,100,150.", cxxopts::value<std::vector<float>>(), "x,...")
+                ("fft_cache", "keep the fastest muFFT plan variant and the level calibration of --engine fft in the file PATH, keyed by fft_size, input_size, sample rate and CPU. the first start with a configuration times the variants, later ones skip both steps.", cxxopts::value<std::string>()->default_value(""), "PATH")
+                ("stft", "analyze every hop of the input: draw 'each' frame, or the 'max' or 'mean' of the frames since the last draw.", cxxopts::value<std::string>()->default_value("off"), "{\'off\'|\'each\'|\'max\'|\'mean\'}")
                 ;
 
             auto result = options.parse(argc, argv);
@@ -93,6 +180,15 @@ public:
                 return false;
             }
 
+            std::string windowStr = result["window"].as<std::string>();
+            std::transform(windowStr.begin(), windowStr.end(), windowStr.begin(), tolower);
+            if (!WindowFunction::Parse(windowStr, windowType))
+            {
+                std::cerr << "error: --window \'" << windowStr  << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       window must be one of 'hamming', 'hann', 'blackman_harris', 'kaiser' or 'flat_top'.\n";
+                return false;
+            }
+
             windowSize = result["gaussian_diameter"].as<int>();
             smoothing = result["smoothing"].as<float>();
 
@@ -115,24 +211,425 @@ public:
 
             std::string lineFeedStr = result["line_feed"].as<std::string>();
             std::transform(lineFeedStr.begin(), lineFeedStr.end(), lineFeedStr.begin(), toupper);
-            if (lineFeedStr == "CR")
+            if (!ParseLineFeed(lineFeedStr, lineFeed))
             {
-                lineFeed = std::string("\r");
+                std::cerr << "error: --line_feed \'" << lineFeedStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       line_feed must be either 'CR', 'LF' or 'CRLF'.\n";
+                return false;
             }
-            else if (lineFeedStr == "LF")
+
+            std::string displayStr = result["display"].as<std::string>();
+            std::transform(displayStr.begin(), displayStr.end(), displayStr.begin(), tolower);
+            if (!ParseRenderMode(displayStr, renderMode))
             {
-                lineFeed = std::string("\n");
+                std::cerr << "error: --display \'" << displayStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       display must be either 'line', 'bars' or 'waterfall'.\n";
+                return false;
             }
-            else if (lineFeedStr == "CRLF")
+
+            rows = result["rows"].as<int>();
+            if (rows < 1)
+            {
+                std::cerr << "error: --rows \'" << rows << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       rows must be positive.\n";
+                return false;
+            }
+
+            std::string outputStr = result["output"].as<std::string>();
+            std::transform(outputStr.begin(), outputStr.end(), outputStr.begin(), tolower);
+            if (outputStr == "text")
             {
-                lineFeed = std::string("\r\n");
+                outputFormat = OutputFormat::Text;
+            }
+            else if (outputStr == "binary")
+            {
+                outputFormat = OutputFormat::Binary;
+            }
+            else if (outputStr == "none")
+            {
+                outputFormat = OutputFormat::None;
             }
             else
             {
-                std::cerr << "error: --line_feed \'" << lineFeedStr << "\'" << " is invalid parameter." << std::endl;
-                std::cerr << "       line_feed must be either 'CR', 'LF' or 'CRLF'.\n";
+                std::cerr << "error: --output \'" << outputStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       output must be either 'text', 'binary' or 'none'.\n";
+                return false;
+            }
+
+            std::string binaryFormatStr = result["binary_format"].as<std::string>();
+            std::transform(binaryFormatStr.begin(), binaryFormatStr.end(), binaryFormatStr.begin(), tolower);
+            if (binaryFormatStr == "f32")
+            {
+                binaryFormat = BinaryFormat::F32;
+            }
+            else if (binaryFormatStr == "u8")
+            {
+                binaryFormat = BinaryFormat::U8;
+            }
+            else
+            {
+                std::cerr << "error: --binary_format \'" << binaryFormatStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       binary_format must be either 'f32' or 'u8'.\n";
+                return false;
+            }
+
+            shmName = result["shm"].as<std::string>();
+#ifdef _WIN32
+            if (!shmName.empty())
+            {
+                std::cerr << "error: --shm is not supported on Windows." << std::endl;
+                return false;
+            }
+#endif
+
+            socketPath = result["serve"].as<std::string>();
+#ifndef __linux__
+            if (!socketPath.empty())
+            {
+                std::cerr << "error: --serve is only supported on Linux." << std::endl;
+                return false;
+            }
+#endif
+
+            statsPath = result["stats"].as<std::string>();
+            statsInterval = result["stats_interval"].as<float>();
+#ifndef ANALYZER_STATS
+            if (!statsPath.empty())
+            {
+                std::cerr << "error: --stats is not available, this build was compiled without ANALYZER_STATS." << std::endl;
+                return false;
+            }
+#endif
+            if (!(0.0f < statsInterval))
+            {
+                std::cerr << "error: --stats_interval \'" << statsInterval << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       stats_interval must be positive.\n";
+                return false;
+            }
+
+            std::string lowLatencyStr = result["low_latency"].as<std::string>();
+            std::transform(lowLatencyStr.begin(), lowLatencyStr.end(), lowLatencyStr.begin(), tolower);
+            if (lowLatencyStr == "on")
+            {
+                lowLatency = true;
+            }
+            else if (lowLatencyStr == "off")
+            {
+                lowLatency = false;
+            }
+            else
+            {
+                std::cerr << "error: --low_latency \'" << lowLatencyStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       low_latency must be either 'on' or 'off'.\n";
+                return false;
+            }
+
+            std::string sourceStr = result["source"].as<std::string>();
+            std::transform(sourceStr.begin(), sourceStr.end(), sourceStr.begin(), tolower);
+            if (sourceStr == "device")
+            {
+                source = CaptureSource::Device;
+            }
+            else if (sourceStr == "stdin")
+            {
+                source = CaptureSource::Stdin;
+            }
+            else if (sourceStr == "replay")
+            {
+                source = CaptureSource::Replay;
+            }
+            else if (sourceStr == "generator")
+            {
+                source = CaptureSource::Generator;
+            }
+            else
+            {
+                std::cerr << "error: --source \'" << sourceStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       source must be either 'device', 'stdin', 'replay' or 'generator'.\n";
+                return false;
+            }
+
+            std::string signalStr = result["signal"].as<std::string>();
+            std::transform(signalStr.begin(), signalStr.end(), signalStr.begin(), tolower);
+            if (signalStr == "sweep")
+            {
+                signal = SignalType::Sweep;
+            }
+            else if (signalStr == "multitone")
+            {
+                signal = SignalType::Multitone;
+            }
+            else if (signalStr == "white")
+            {
+                signal = SignalType::White;
+            }
+            else if (signalStr == "pink")
+            {
+                signal = SignalType::Pink;
+            }
+            else if (signalStr == "silence")
+            {
+                signal = SignalType::Silence;
+            }
+            else
+            {
+                std::cerr << "error: --signal \'" << signalStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       signal must be either 'sweep', 'multitone', 'white', 'pink' or 'silence'.\n";
+                return false;
+            }
+
+            signalSpeed = result["signal_speed"].as<float>();
+            if (!(0.0f < signalSpeed))
+            {
+                std::cerr << "error: --signal_speed \'" << signalSpeed << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       signal_speed must be positive.\n";
+                return false;
+            }
+
+            signalDuration = result["signal_duration"].as<float>();
+            if (!(0.0f <= signalDuration))
+            {
+                std::cerr << "error: --signal_duration \'" << signalDuration << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       signal_duration must be 0 or positive.\n";
+                return false;
+            }
+
+            recordPath = result["record"].as<std::string>();
+            replayPath = result["replay"].as<std::string>();
+            if (source == CaptureSource::Replay && replayPath.empty())
+            {
+                std::cerr << "error: --source replay requires --replay PATH." << std::endl;
+                return false;
+            }
+
+            std::string formatStr = result["format"].as<std::string>();
+            std::transform(formatStr.begin(), formatStr.end(), formatStr.begin(), tolower);
+            if (formatStr == "s16le")
+            {
+                streamFormat = StreamFormat::S16LE;
+            }
+            else if (formatStr == "f32le")
+            {
+                streamFormat = StreamFormat::F32LE;
+            }
+            else if (formatStr == "wav")
+            {
+                streamFormat = StreamFormat::Wav;
+            }
+            else
+            {
+                std::cerr << "error: --format \'" << formatStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       format must be either 's16le', 'f32le' or 'wav'.\n";
+                return false;
+            }
+
+            channels = result["channels"].as<int>();
+            if (channels < 1)
+            {
+                std::cerr << "error: --channels \'" << channels << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       channels must be at least 1.\n";
+                return false;
+            }
+
+            std::string channelModeStr = result["channel_mode"].as<std::string>();
+            std::transform(channelModeStr.begin(), channelModeStr.end(), channelModeStr.begin(), tolower);
+            if (channelModeStr == "first")
+            {
+                channelMode = ChannelMode::First;
+            }
+            else if (channelModeStr == "stack")
+            {
+                channelMode = ChannelMode::Stack;
+            }
+            else if (channelModeStr == "max")
+            {
+                channelMode = ChannelMode::Max;
+            }
+            else if (channelModeStr == "mean")
+            {
+                channelMode = ChannelMode::Mean;
+            }
+            else if (channelModeStr == "mid_side")
+            {
+                channelMode = ChannelMode::MidSide;
+            }
+            else
+            {
+                std::cerr << "error: --channel_mode \'" << channelModeStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       channel_mode must be either 'first', 'stack', 'max', 'mean' or 'mid_side'.\n";
+                return false;
+            }
+
+            samplingFrequency = result["sample_rate"].as<int>();
+            if (samplingFrequency < 0)
+            {
+                std::cerr << "error: --sample_rate \'" << samplingFrequency << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       sample_rate must be 0 or positive.\n";
+                return false;
+            }
+            // only a device has a native rate
+            if (samplingFrequency == 0 && source != CaptureSource::Device)
+            {
+                samplingFrequency = DefaultSampleRate;
+            }
+
+            std::string realtimeStr = result["realtime"].as<std::string>();
+            std::transform(realtimeStr.begin(), realtimeStr.end(), realtimeStr.begin(), tolower);
+            if (realtimeStr == "on")
+            {
+                realtime = true;
+            }
+            else if (realtimeStr == "off")
+            {
+                realtime = false;
+            }
+            else
+            {
+                std::cerr << "error: --realtime \'" << realtimeStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       realtime must be either 'on' or 'off'.\n";
+                return false;
+            }
+
+            fps = result["fps"].as<float>();
+            if (fps <= 0.0f)
+            {
+                std::cerr << "error: --fps \'" << fps << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       fps must be positive.\n";
+                return false;
+            }
+
+            hopSize = result["hop"].as<int>();
+            if (hopSize < 0)
+            {
+                std::cerr << "error: --hop \'" << hopSize << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       hop must be greater or equal to 0.\n";
+                return false;
+            }
+
+            std::string stftStr = result["stft"].as<std::string>();
+            std::transform(stftStr.begin(), stftStr.end(), stftStr.begin(), tolower);
+            if (stftStr == "off")
+            {
+                stftMode = StftMode::Off;
+            }
+            else if (stftStr == "each")
+            {
+                stftMode = StftMode::Each;
+            }
+            else if (stftStr == "max")
+            {
+                stftMode = StftMode::Max;
+            }
+            else if (stftStr == "mean")
+            {
+                stftMode = StftMode::Mean;
+            }
+            else
+            {
+                std::cerr << "error: --stft \'" << stftStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       stft must be either 'off', 'each', 'max' or 'mean'.\n";
                 return false;
             }
+
+            std::string engineStr = result["engine"].as<std::string>();
+            std::transform(engineStr.begin(), engineStr.end(), engineStr.begin(), tolower);
+            if (engineStr == "fft")
+            {
+                engine = AnalyzerEngine::Fft;
+            }
+            else if (engineStr == "sdft")
+            {
+                engine = AnalyzerEngine::SlidingDft;
+            }
+            else if (engineStr == "multires")
+            {
+                engine = AnalyzerEngine::MultiResolution;
+            }
+            else
+            {
+                std::cerr << "error: --engine \'" << engineStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       engine must be either 'fft', 'sdft' or 'multires'.\n";
+                return false;
+            }
+
+            fftCachePath = result["fft_cache"].as<std::string>();
+
+            octaveFftSize = result["octave_fft_size"].as<int>();
+            if (engine == AnalyzerEngine::MultiResolution
+                && (std::none_of(nList.begin(), nList.end(), [this](int n){ return n == octaveFftSize; }) || fftSize < octaveFftSize))
+            {
+                std::cerr << "error: --octave_fft_size \'" << octaveFftSize << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       octave_fft_size must be a power of two from " << nList.front() << " up to the fft_size=" << fftSize << ".\n";
+                return false;
+            }
+
+            trackedFrequencies.clear();
+            if (result.count("track_freqs"))
+            {
+                trackedFrequencies = result["track_freqs"].as<std::vector<float>>();
+            }
+            for (const float freq : trackedFrequencies)
+            {
+                if (!(0.0f < freq))
+                {
+                    std::cerr << "error: --track_freqs \'" << freq << "\'" << " is invalid parameter." << std::endl;
+                    std::cerr << "       tracked frequencies must be positive.\n";
+                    return false;
+                }
+            }
+
+            if (engine == AnalyzerEngine::SlidingDft && trackedFrequencies.empty())
+            {
+                std::cerr << "error: --engine \'" << engineStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       the sliding DFT requires --track_freqs.\n";
+                return false;
+            }
+
+            if (engine != AnalyzerEngine::Fft && (stftMode != StftMode::Off || channelMode != ChannelMode::First))
+            {
+                std::cerr << "error: --engine \'" << engineStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       " << engineStr << " analyzes the first channel as the samples arrive and requires --stft off and --channel_mode first.\n";
+                return false;
+            }
+
+            profiles.clear();
+            if (result.count("profile"))
+            {
+                for (const auto& profileStr : result["profile"].as<std::vector<std::string>>())
+                {
+                    OutputProfile profile = defaultProfile();
+                    if (!parseProfile(profileStr, profile))
+                    {
+                        return false;
+                    }
+                    profiles.push_back(profile);
+                }
+            }
+            else
+            {
+                profiles.push_back(defaultProfile());
+            }
+
+            if (1 < std::count_if(profiles.begin(), profiles.end(), [](const OutputProfile& profile) { return profile.outputPath.empty(); }))
+            {
+                std::cerr << "error: --profile is invalid parameter." << std::endl;
+                std::cerr << "       at most one profile may write to stdout, give the others an output.\n";
+                return false;
+            }
+
+            if (stftMode != StftMode::Off && channelMode != ChannelMode::First)
+            {
+                std::cerr << "error: --stft \'" << stftStr << "\'" << " is invalid parameter." << std::endl;
+                std::cerr << "       stft analyzes the first channel only and requires --channel_mode first.\n";
+                return false;
+            }
+
+#ifdef ANALYZER_FIXED_CONFIG
+            if (!checkFixedConfig())
+            {
+                return false;
+            }
+#endif
         }
         catch (const std::exception& e)
         {
@@ -150,6 +647,53 @@ public:
         return initialized;
     }
 
+    size_t stftHopSize()const
+    {
+        return 0 < hopSize ? hopSize : std::max(1, inputSize / 4);
+    }
+
+    // The samples that trigger a frame, for the FrameScheduler: --hop, or with --low_latency a frame
+    // period worth of samples, so that frames follow the samples instead of the clock. 0 for the clock.
+    size_t frameHopSize(int sampleRate)const
+    {
+        if (0 < hopSize)
+        {
+            return hopSize;
+        }
+
+        return lowLatency ? std::max<size_t>(1, static_cast<size_t>(sampleRate / fps)) : 0;
+    }
+
+    // octaves of --engine multires, the lowest one having the bin spacing of fft_size
+    size_t multiResolutionLevels()const
+    {
+        size_t levels = 1;
+        while ((static_cast<size_t>(octaveFftSize) << (levels - 1)) < static_cast<size_t>(fftSize))
+        {
+            ++levels;
+        }
+        return levels;
+    }
+
+    // The STFT needs some history beyond the latest input_size samples. The sliding DFT and the
+    // multiresolution engine consume every sample, so the buffer also keeps those of a frame period
+    // (or hop) and of half a second more for frames that come late; the lowest octave of multires
+    // spans fft_size samples, which the buffer holds on its own after a longer gap.
+    size_t captureBufferSize(int sampleRate)const
+    {
+        const size_t slack = std::max(static_cast<size_t>(sampleRate / fps), static_cast<size_t>(hopSize)) + sampleRate / 2;
+
+        switch (engine)
+        {
+        case AnalyzerEngine::SlidingDft:
+            return inputSize + slack;
+        case AnalyzerEngine::MultiResolution:
+            return fftSize + slack;
+        default:
+            return stftMode == StftMode::Off ? inputSize : inputSize + sampleRate / 2;
+        }
+    }
+
     int characterSize = 0;
     float bottomLevel = 0;
     float topLevel = 0;
@@ -158,12 +702,275 @@ public:
     float axisLogBase = 0;
     int fftSize = 0;
     int inputSize = 0;
+    WindowType windowType = WindowType::Hamming;
     int windowSize = 0;
     float smoothing = 0;
     bool displayAxis = false;
     std::string lineFeed;
+    RenderMode renderMode = RenderMode::Line;
+    int rows = 0;
+    OutputFormat outputFormat = OutputFormat::Text;
+    BinaryFormat binaryFormat = BinaryFormat::F32;
+    std::string shmName;
+    std::string socketPath;
+    std::string fftCachePath;
+    std::string statsPath;
+    float statsInterval = 0;
+    bool lowLatency = false;
+    CaptureSource source = CaptureSource::Device;
+    std::string recordPath;
+    std::string replayPath;
+    SignalType signal = SignalType::Sweep;
+    float signalSpeed = 0;
+    float signalDuration = 0;
+    StreamFormat streamFormat = StreamFormat::S16LE;
+    std::vector<OutputProfile> profiles;
+    int channels = 0;
+    ChannelMode channelMode = ChannelMode::First;
+    // 0 for the native rate of the device
+    int samplingFrequency = 0;
+    bool realtime = true;
+    float fps = 0;
+    int hopSize = 0;
+    StftMode stftMode = StftMode::Off;
+    AnalyzerEngine engine = AnalyzerEngine::Fft;
+    std::vector<float> trackedFrequencies;
+    int octaveFftSize = 0;
 
 private:
 
+    // of the sources without a native rate
+    static constexpr int DefaultSampleRate = 48000;
+
+    static bool ParseLineFeed(const std::string& str, std::string& lineFeed)
+    {
+        if (str == "CR")
+        {
+            lineFeed = std::string("\r");
+        }
+        else if (str == "LF")
+        {
+            lineFeed = std::string("\n");
+        }
+        else if (str == "CRLF")
+        {
+            lineFeed = std::string("\r\n");
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    static bool ParseRenderMode(const std::string& str, RenderMode& mode)
+    {
+        if (str == "line")
+        {
+            mode = RenderMode::Line;
+        }
+        else if (str == "bars")
+        {
+            mode = RenderMode::Bars;
+        }
+        else if (str == "waterfall")
+        {
+            mode = RenderMode::Waterfall;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    template<class T>
+    static bool ParseValue(const std::string& str, T& value)
+    {
+        std::istringstream is(str);
+        is >> value;
+        return !is.fail() && is.eof();
+    }
+
+#ifdef ANALYZER_FIXED_CONFIG
+    // A build specialized with ANALYZER_FIXED_CONFIG draws one text line of the FFT of the first channel,
+    // with the sizes and the window it was compiled for.
+    bool checkFixedConfig()const
+    {
+        const auto printError = [](const std::string& option, const std::string& message)
+        {
+            std::cerr << "error: --" << option << " is invalid parameter." << std::endl;
+            std::cerr << "       this build is specialized (ANALYZER_FIXED_CONFIG) and " << message << "\n";
+            return false;
+        };
+
+        if (fftSize != ANALYZER_FIXED_FFT_SIZE)
+        {
+            return printError("fft_size", "requires fft_size=" + std::to_string(ANALYZER_FIXED_FFT_SIZE) + ".");
+        }
+        if (inputSize != ANALYZER_FIXED_INPUT_SIZE)
+        {
+            return printError("input_size", "requires input_size=" + std::to_string(ANALYZER_FIXED_INPUT_SIZE) + ".");
+        }
+        if (characterSize != ANALYZER_FIXED_CHARS)
+        {
+            return printError("chars", "requires chars=" + std::to_string(ANALYZER_FIXED_CHARS) + ".");
+        }
+        if (windowType != WindowType::ANALYZER_FIXED_WINDOW)
+        {
+            return printError("window", "only supports the window it was built with.");
+        }
+        if (1 < profiles.size())
+        {
+            return printError("profile", "draws a single profile.");
+        }
+        if (outputFormat != OutputFormat::Text || !shmName.empty() || !socketPath.empty())
+        {
+            return printError("output", "only draws text to stdout, without --shm or --serve.");
+        }
+        if (!statsPath.empty())
+        {
+            return printError("stats", "is not instrumented.");
+        }
+        if (!fftCachePath.empty())
+        {
+            return printError("fft_cache", "does not tune its plan.");
+        }
+        if (renderMode != RenderMode::Line)
+        {
+            return printError("display", "draws a single line.");
+        }
+        if (engine != AnalyzerEngine::Fft || stftMode != StftMode::Off)
+        {
+            return printError("engine", "requires --engine fft and --stft off.");
+        }
+        if (channelMode != ChannelMode::First)
+        {
+            return printError("channel_mode", "analyzes the first channel only.");
+        }
+
+        return true;
+    }
+#endif
+
+    // the profile made of the options outside of --profile
+    OutputProfile defaultProfile()const
+    {
+        OutputProfile profile;
+        profile.characterSize = characterSize;
+        profile.bottomLevel = bottomLevel;
+        profile.topLevel = topLevel;
+        profile.minFreq = minFreq;
+        profile.maxFreq = maxFreq;
+        profile.axisLogBase = axisLogBase;
+        profile.windowSize = windowSize;
+        profile.smoothing = smoothing;
+        profile.displayAxis = displayAxis;
+        profile.lineFeed = lineFeed;
+        profile.renderMode = renderMode;
+        profile.rows = rows;
+        return profile;
+    }
+
+    // parses 'key=value:key=value:...' over the values already in profile
+    bool parseProfile(const std::string& str, OutputProfile& profile)const
+    {
+        const auto printError = [&](const std::string& message)
+        {
+            std::cerr << "error: --profile \'" << str << "\'" << " is invalid parameter." << std::endl;
+            std::cerr << "       " << message << "\n";
+            return false;
+        };
+
+        size_t begin = 0;
+        while (begin < str.size())
+        {
+            const size_t equal = str.find('=', begin);
+            if (equal == std::string::npos)
+            {
+                return printError("each entry must be key=value.");
+            }
+
+            const std::string key = str.substr(begin, equal - begin);
+
+            // the output path takes the rest of the string, so that it may contain ':'
+            const size_t end = key == "output" ? str.size() : std::min(str.find(':', equal), str.size());
+            std::string value = str.substr(equal + 1, end - equal - 1);
+            begin = end + 1;
+
+            bool valid = true;
+            if (key == "chars")
+            {
+                valid = ParseValue(value, profile.characterSize) && 0 < profile.characterSize;
+            }
+            else if (key == "top_db")
+            {
+                valid = ParseValue(value, profile.topLevel) && profile.topLevel <= 0.0f;
+            }
+            else if (key == "bottom_db")
+            {
+                valid = ParseValue(value, profile.bottomLevel) && profile.bottomLevel <= 0.0f;
+            }
+            else if (key == "lower_freq")
+            {
+                valid = ParseValue(value, profile.minFreq);
+            }
+            else if (key == "upper_freq")
+            {
+                valid = ParseValue(value, profile.maxFreq);
+            }
+            else if (key == "axis_log_base")
+            {
+                valid = ParseValue(value, profile.axisLogBase);
+            }
+            else if (key == "gaussian_diameter")
+            {
+                valid = ParseValue(value, profile.windowSize) && 0 < profile.windowSize;
+            }
+            else if (key == "smoothing")
+            {
+                valid = ParseValue(value, profile.smoothing);
+            }
+            else if (key == "axis")
+            {
+                std::transform(value.begin(), value.end(), value.begin(), tolower);
+                valid = value == "on" || value == "off";
+                profile.displayAxis = value == "on";
+            }
+            else if (key == "line_feed")
+            {
+                std::transform(value.begin(), value.end(), value.begin(), toupper);
+                valid = ParseLineFeed(value, profile.lineFeed);
+            }
+            else if (key == "display")
+            {
+                std::transform(value.begin(), value.end(), value.begin(), tolower);
+                valid = ParseRenderMode(value, profile.renderMode);
+            }
+            else if (key == "rows")
+            {
+                valid = ParseValue(value, profile.rows) && 0 < profile.rows;
+            }
+            else if (key == "output")
+            {
+                valid = !value.empty();
+                profile.outputPath = value;
+            }
+            else
+            {
+                return printError("unknown key '" + key + "'.");
+            }
+
+            if (!valid)
+            {
+                return printError("'" + value + "' is invalid for " + key + ".");
+            }
+        }
+
+        return true;
+    }
+
     int initialized = false;
 };
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#endif
+
+// Destination of the frames: stdout, or a file (or named pipe) given to open().
+// Each write() goes straight to the file descriptor, so a frame is never split by stdio buffering.
+class OutputFile
+{
+public:
+
+    OutputFile() = default;
+
+    OutputFile(const OutputFile&) = delete;
+    OutputFile& operator=(const OutputFile&) = delete;
+
+    ~OutputFile()
+    {
+        if (file != StdoutFile)
+        {
+#ifdef _WIN32
+            _close(file);
+#else
+            ::close(file);
+#endif
+        }
+    }
+
+    bool open(const std::string& path)
+    {
+#ifdef _WIN32
+        file = _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+        file = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        if (file < 0)
+        {
+            std::cerr << "error: cannot open \'" << path << "\': " << std::strerror(errno) << std::endl;
+            file = StdoutFile;
+            return false;
+        }
+
+        return true;
+    }
+
+    // keeps binary frames intact on Windows, where stdout translates LF to CRLF by default
+    void setBinary()
+    {
+#ifdef _WIN32
+        _setmode(file, _O_BINARY);
+#endif
+    }
+
+    void write(const std::string& text)
+    {
+        write(text.data(), text.size());
+    }
+
+    void write(const void* data, size_t size)
+    {
+        if (isFirst && file == StdoutFile)
+        {
+            // anything printed through iostreams before must come first
+            std::cout << std::flush;
+        }
+        isFirst = false;
+
+        const char* p = static_cast<const char*>(data);
+        while (0 < size)
+        {
+#ifdef _WIN32
+            const int written = _write(file, p, static_cast<unsigned int>(size));
+#else
+            const ssize_t written = ::write(file, p, size);
+#endif
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                return;
+            }
+
+            p += written;
+            size -= written;
+        }
+    }
+
+private:
+
+    static constexpr int StdoutFile = 1;
+    int file = StdoutFile;
+    bool isFirst = true;
+};
@@ -1,38 +1,217 @@
+#pragma once
+
+#include <array>
 #include <vector>
 #include <numeric>
 #include <string>
+#include <string_view>
 #include <iostream>
 #include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <cstdint>
+
+#include "OutputFile.hpp"
+#include "FrameStats.hpp"
+#include "TerminalGrid.hpp"
+
+enum class RenderMode
+{
+    Line,       // one line of Braille bars per spectrum
+    Bars,       // bars of height Braille rows
+    Waterfall,  // the latest height frames as shades, the newest on top
+};
 
+// Draws the spectrum as one line of Braille characters, or several spectra as stacked lines.
+// A frame is assembled in a preallocated buffer and written to stdout (or the file given to open())
+// with a single write().
+//
+// The Bars and Waterfall modes draw height rows per spectrum on a terminal. They go through a
+// TerminalGrid, so a frame only writes the cells that changed and the line feed is not used.
 class Renderer
 {
 public:
 
     Renderer() = default;
 
-    Renderer(size_t width, const std::string& lineFeed)
-        : width(width)
-        , lineFeed(lineFeed)
+    Renderer(size_t width, const std::string& lineFeed, RenderMode mode = RenderMode::Line, size_t height = 1)
+        : lineFeed(lineFeed)
+        , width(width)
+        , mode(mode)
+        , height(mode == RenderMode::Line ? 1 : std::max<size_t>(1, height))
     {}
 
+    // Writes the frames to a file (or a named pipe) instead of stdout.
+    bool open(const std::string& path)
+    {
+        return output.open(path);
+    }
+
+    // writes text (e.g. the axis) to the output as is
+    void write(const std::string& text)
+    {
+        output.write(text);
+    }
+
+    // text appended to every frame, e.g. the bottom axis label
+    void setFooter(const std::string& text)
+    {
+        footer = text;
+    }
+
     void draw(const std::vector<float>& values, int windowSize, float smoothing, bool displayAxis)
     {
-        const std::string str("⠀⠁⠂⠃⠄⠅⠆⠇⡀⡁⡂⡃⡄⡅⡆⡇⠈⠉⠊⠋⠌⠍⠎⠏⡈⡉⡊⡋⡌⡍⡎⡏⠐⠑⠒⠓⠔⠕⠖⠗⡐⡑⡒⡓⡔⡕⡖⡗⠘⠙⠚⠛⠜⠝⠞⠟⡘⡙⡚⡛⡜⡝⡞⡟⠠⠡⠢⠣⠤⠥⠦⠧⡠⡡⡢⡣⡤⡥⡦⡧⠨⠩⠪⠫⠬⠭⠮⠯⡨⡩⡪⡫⡬⡭⡮⡯⠰⠱⠲⠳⠴⠵⠶⠷⡰⡱⡲⡳⡴⡵⡶⡷⠸⠹⠺⠻⠼⠽⠾⠿⡸⡹⡺⡻⡼⡽⡾⡿⢀⢁⢂⢃⢄⢅⢆⢇⣀⣁⣂⣃⣄⣅⣆⣇⢈⢉⢊⢋⢌⢍⢎⢏⣈⣉⣊⣋⣌⣍⣎⣏⢐⢑⢒⢓⢔⢕⢖⢗⣐⣑⣒⣓⣔⣕⣖⣗⢘⢙⢚⢛⢜⢝⢞⢟⣘⣙⣚⣛⣜⣝⣞⣟⢠⢡⢢⢣⢤⢥⢦⢧⣠⣡⣢⣣⣤⣥⣦⣧⢨⢩⢪⢫⢬⢭⢮⢯⣨⣩⣪⣫⣬⣭⣮⣯⢰⢱⢲⢳⢴⢵⢶⢷⣰⣱⣲⣳⣴⣵⣶⣷⢸⢹⢺⢻⢼⢽⢾⢿⣸⣹⣺⣻⣼⣽⣾⣿");
+        const std::vector<float>* row = &values;
+        drawRows(&row, 1, windowSize, smoothing, displayAxis);
+    }
 
-        const int bs[] = {0, 0x8, 0xc, 0xe, 0xf};
-        //const int bs[] = {0, 0x8, 0x4, 0x2, 0x1};
+    // Draws several spectra as stacked lines, e.g. one per channel.
+    void draw(const std::vector<const std::vector<float>*>& rows, int windowSize, float smoothing, bool displayAxis)
+    {
+        drawRows(rows.data(), rows.size(), windowSize, smoothing, displayAxis);
+    }
+
+    // Builds the next frame without writing it.
+    const std::string& render(const std::vector<float>& values, int windowSize, float smoothing, bool displayAxis)
+    {
+        const std::vector<float>* row = &values;
+        return render(&row, 1, windowSize, smoothing, displayAxis);
+    }
+
+    // Records the time of render() and of the writes in stats (see --stats), nullptr to stop.
+    void setStats(FrameStats* frameStats)
+    {
+        stats = frameStats;
+    }
+
+    // the last frame without the line feed and cursor movement in front of it
+    std::string_view frameText()const
+    {
+        if (mode != RenderMode::Line)
+        {
+            // rebuilt in place, so that it stops allocating once it has grown to a frame
+            gridText.clear();
+            grid.text(gridText);
+            return gridText;
+        }
+
+        return std::string_view(line).substr(bodyOffset);
+    }
+
+    const std::string& render(const std::vector<float>* const* rows, size_t rowCount, int windowSize, float smoothing, bool displayAxis)
+    {
+        ANALYZER_STATS_SCOPE(stats, Stage::Render);
+
+        if (mode != RenderMode::Line)
+        {
+            return renderGrid(rows, rowCount, windowSize, smoothing, displayAxis);
+        }
+
+        line.clear();
+        if (line.capacity() == 0)
+        {
+            line.reserve(lineFeed.size() + 16 + rowCount * (width + 3) * 3 + footer.size());
+        }
 
         if (!isFirst)
         {
-            std::cout << lineFeed;
+            line += lineFeed;
+
+            // without a newline in the line feed each frame overwrites the previous one,
+            // so the cursor goes back up to the first line
+            if (1 < rowCount && lineFeed.find('\n') == std::string::npos)
+            {
+                line += "\x1b[";
+                line += std::to_string(rowCount - 1);
+                line += "A";
+            }
         }
         isFirst = false;
+        bodyOffset = line.size();
+
+        if (smoothed.size() < rowCount)
+        {
+            smoothed.resize(rowCount);
+        }
+
+        for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+        {
+            if (rowIndex != 0)
+            {
+                line += "\n";
+            }
+
+            appendRow(*rows[rowIndex], smoothed[rowIndex], windowSize, smoothing, displayAxis);
+        }
+
+        line += footer;
+
+        return line;
+    }
+
+    // Appends the character of two bars, each drawn with 0 to 4 dots in steps of 0.2.
+    static void AppendGlyph(std::string& line, float left, float right)
+    {
+        const int bs[] = {0, 0x8, 0xc, 0xe, 0xf};
+        //const int bs[] = {0, 0x8, 0x4, 0x2, 0x1};
+
+        int index = 0;
+
+        {
+            const int xi = static_cast<int>(left / 0.2f);
+            const int x = std::max(0, std::min(4, xi));
+            index |= bs[x];
+        }
+
+        {
+            const int xi = static_cast<int>(right / 0.2f);
+            const int x = std::max(0, std::min(4, xi));
+            index |= (bs[x] << 4);
+        }
 
+        line.append(glyphs.data() + index * 3, 3);
+    }
+
+    // the unnormalized weight of the bar offset bars away in the Gaussian blur
+    static float GaussianWeight(int offset, float variance)
+    {
+        const float pi = 3.1415926535f;
+        return (1.0f / std::sqrt(2.0f * pi * variance)) * std::exp(-offset * offset / (2.0f * variance));
+    }
+
+private:
+
+    void drawRows(const std::vector<float>* const* rows, size_t rowCount, int windowSize, float smoothing, bool displayAxis)
+    {
+        const std::string& frame = render(rows, rowCount, windowSize, smoothing, displayAxis);
+
+        ANALYZER_STATS_SCOPE(stats, Stage::Output);
+        output.write(frame);
+    }
+
+    void appendRow(const std::vector<float>& values, std::vector<float>& buffer1, int windowSize, float smoothing, bool displayAxis)
+    {
         if (displayAxis)
         {
-            std::cout << "│";
+            line += "│";
+        }
+
+        updateBars(values, buffer1, windowSize, smoothing);
+
+        for (size_t charIndex = 0; charIndex < width; ++charIndex)
+        {
+            AppendGlyph(line, buffer2[charIndex*2 + 0], buffer2[charIndex*2 + 1]);
         }
 
+        if (displayAxis)
+        {
+            line += "│";
+        }
+    }
+
+    // Smooths the bars of values over time into buffer1 and blurs them into buffer2, two bars per character.
+    void updateBars(const std::vector<float>& values, std::vector<float>& buffer1, int windowSize, float smoothing)
+    {
         const size_t resolution = width * 2;
         const size_t unitBarWidth = values.size() / resolution;
 
@@ -51,28 +230,12 @@ public:
             buffer1[barIndex] += (maxValue - buffer1[barIndex]) * smoothing;
         }
 
-        const auto gaussianWeights = [](int windowSize, float variance)
+        if (weights.size() != static_cast<size_t>(windowSize))
         {
-            const float pi = 3.1415926535f;
-            std::vector<float> result(windowSize);
-            int centerIndex = windowSize / 2;
-            for (int i = 0; i < windowSize; ++i)
-            {
-                int currentX = i - centerIndex;
-                result[i] = (1.0f / std::sqrt(2.0f * pi * variance)) * std::exp(-currentX * currentX / (2.0f * variance));
-            }
-
-            float sum = std::accumulate(result.begin(), result.end(), 0.0f);
-            for(int i = 0; i < windowSize; ++i)
-            {
-                result[i] /= sum;
-            }
-
-            return result;
-        };
+            updateGaussianWeights(windowSize, 1.0f);
+        }
 
         buffer2.resize(buffer1.size());
-        const auto weights = gaussianWeights(windowSize, 1.0f);
         for (size_t barIndex = 0; barIndex < resolution; ++barIndex)
         {
             float value = 0.0f;
@@ -84,44 +247,119 @@ public:
 
             buffer2[barIndex] = value;
         }
+    }
 
-        for (size_t charIndex = 0; charIndex < width; ++charIndex)
+    // The grid holds height rows per spectrum. Bars fill 4 dots per row from the bottom,
+    // a waterfall scrolls each block down and draws the new frame as shades on its top row.
+    const std::string& renderGrid(const std::vector<float>* const* rows, size_t rowCount, int windowSize, float smoothing, bool displayAxis)
+    {
+        line.clear();
+
+        if (grid.rowCount() != rowCount * height)
         {
-            const size_t leftIndex = unitBarWidth * (charIndex * 2 + 0);
-            const size_t rightIndex = unitBarWidth * (charIndex * 2 + 1);
+            grid.init(width, rowCount * height, mode == RenderMode::Bars ? BrailleCells().data() : shadeCells.data(), 0, displayAxis, footer);
+        }
 
-            int index = 0;
+        if (smoothed.size() < rowCount)
+        {
+            smoothed.resize(rowCount);
+        }
 
-            {
-                const float v = buffer2[charIndex*2 + 0];
+        const int dotCount = static_cast<int>(height) * 4;
+        const auto dots = [&](float value)
+        {
+            return std::max(0, std::min(dotCount, static_cast<int>(value * (dotCount + 1))));
+        };
 
-                const int xi = static_cast<int>(v / 0.2f);
-                const int x = std::max(0, std::min(4, xi));
-                index |= bs[x];
-            }
+        for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+        {
+            updateBars(*rows[rowIndex], smoothed[rowIndex], windowSize, smoothing);
 
+            const size_t top = rowIndex * height;
+            if (mode == RenderMode::Bars)
             {
-                const float v = buffer2[charIndex*2 + 1];
+                static constexpr std::uint8_t bs[] = {0, 0x8, 0xc, 0xe, 0xf};
+                for (size_t charIndex = 0; charIndex < width; ++charIndex)
+                {
+                    const int left = dots(buffer2[charIndex*2 + 0]);
+                    const int right = dots(buffer2[charIndex*2 + 1]);
+                    for (size_t y = 0; y < height; ++y)
+                    {
+                        // the dots of the bars above the bottom of this row
+                        const int base = static_cast<int>(height - 1 - y) * 4;
+                        const int l = std::max(0, std::min(4, left - base));
+                        const int r = std::max(0, std::min(4, right - base));
+                        grid.set(top + y, charIndex, static_cast<std::uint8_t>(bs[l] | (bs[r] << 4)));
+                    }
+                }
+            }
+            else
+            {
+                grid.scrollDown(top, top + height, line);
+                for (size_t charIndex = 0; charIndex < width; ++charIndex)
+                {
+                    const float value = std::max(buffer2[charIndex*2 + 0], buffer2[charIndex*2 + 1]);
+                    grid.set(top, charIndex, static_cast<std::uint8_t>(std::max(0, std::min(4, static_cast<int>(value * 5.0f)))));
+                }
+            }
+        }
 
-                const int xi = static_cast<int>(v / 0.2f);
-                const int x = std::max(0, std::min(4, xi));
-                index |= (bs[x] << 4);
+        grid.update(line);
+
+        return line;
+    }
+
+    // the Braille patterns by index, as TerminalGrid cells
+    static const std::array<std::string_view, 256>& BrailleCells()
+    {
+        static const std::array<std::string_view, 256> cells = []
+        {
+            std::array<std::string_view, 256> result;
+            for (size_t i = 0; i < result.size(); ++i)
+            {
+                result[i] = glyphs.substr(i * 3, 3);
             }
+            return result;
+        }();
+        return cells;
+    }
 
-            std::cout << str.substr(index*3, 3);
+    static constexpr std::array<std::string_view, 5> shadeCells = {" ", "░", "▒", "▓", "█"};
+
+    // UTF-8 Braille patterns, 3 bytes each, indexed by the dot bits of the left (low 4 bits) and right column
+    static constexpr std::string_view glyphs = "⠀⠁⠂⠃⠄⠅⠆⠇⡀⡁⡂⡃⡄⡅⡆⡇⠈⠉⠊⠋⠌⠍⠎⠏⡈⡉⡊⡋⡌⡍⡎⡏⠐⠑⠒⠓⠔⠕⠖⠗⡐⡑⡒⡓⡔⡕⡖⡗⠘⠙⠚⠛⠜⠝⠞⠟⡘⡙⡚⡛⡜⡝⡞⡟⠠⠡⠢⠣⠤⠥⠦⠧⡠⡡⡢⡣⡤⡥⡦⡧⠨⠩⠪⠫⠬⠭⠮⠯⡨⡩⡪⡫⡬⡭⡮⡯⠰⠱⠲⠳⠴⠵⠶⠷⡰⡱⡲⡳⡴⡵⡶⡷⠸⠹⠺⠻⠼⠽⠾⠿⡸⡹⡺⡻⡼⡽⡾⡿⢀⢁⢂⢃⢄⢅⢆⢇⣀⣁⣂⣃⣄⣅⣆⣇⢈⢉⢊⢋⢌⢍⢎⢏⣈⣉⣊⣋⣌⣍⣎⣏⢐⢑⢒⢓⢔⢕⢖⢗⣐⣑⣒⣓⣔⣕⣖⣗⢘⢙⢚⢛⢜⢝⢞⢟⣘⣙⣚⣛⣜⣝⣞⣟⢠⢡⢢⢣⢤⢥⢦⢧⣠⣡⣢⣣⣤⣥⣦⣧⢨⢩⢪⢫⢬⢭⢮⢯⣨⣩⣪⣫⣬⣭⣮⣯⢰⢱⢲⢳⢴⢵⢶⢷⣰⣱⣲⣳⣴⣵⣶⣷⢸⢹⢺⢻⢼⢽⢾⢿⣸⣹⣺⣻⣼⣽⣾⣿";
+
+    void updateGaussianWeights(int windowSize, float variance)
+    {
+        weights.resize(windowSize);
+        int centerIndex = windowSize / 2;
+        for (int i = 0; i < windowSize; ++i)
+        {
+            weights[i] = GaussianWeight(i - centerIndex, variance);
         }
 
-        if (displayAxis)
+        float sum = std::accumulate(weights.begin(), weights.end(), 0.0f);
+        for(int i = 0; i < windowSize; ++i)
         {
-            std::cout << "│";
+            weights[i] /= sum;
         }
     }
 
-private:
-
-    std::vector<float> buffer1;
+    // smoothed bar heights of each row
+    std::vector<std::vector<float>> smoothed;
     std::vector<float> buffer2;
+    std::vector<float> weights;
+    std::string line;
+    std::string footer;
     std::string lineFeed;
     size_t width;
+    RenderMode mode = RenderMode::Line;
+    size_t height = 1;
+    TerminalGrid grid;
+    mutable std::string gridText;
     bool isFirst = true;
+    size_t bodyOffset = 0;
+    FrameStats* stats = nullptr;
+
+    OutputFile output;
 };
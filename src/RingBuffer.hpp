@@ -0,0 +1,118 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <cstring>
+#include <cassert>
+#include <algorithm>
+
+// Lock-free ring buffer for one producer thread and one consumer thread.
+// The producer never waits for the consumer: old values are simply overwritten.
+// The consumer copies the latest values and, like a seqlock, retries if the producer
+// has started to overwrite them while they were being copied.
+// Multi-channel data is stored as planes of the same capacity that share one write position,
+// so a snapshot always has the same frames in every plane.
+template<class T>
+class SPSCRingBuffer
+{
+public:
+
+    SPSCRingBuffer() = default;
+
+    void init(size_t minCapacity, size_t planeCount = 1)
+    {
+        capacity = 1;
+        while (capacity < minCapacity)
+        {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        this->planeCount = std::max<size_t>(1, planeCount);
+
+        data.assign(capacity * this->planeCount, T());
+        writeIndex.store(0, std::memory_order_relaxed);
+        reserveIndex.store(0, std::memory_order_relaxed);
+    }
+
+    size_t size()const
+    {
+        return capacity;
+    }
+
+    size_t planes()const
+    {
+        return planeCount;
+    }
+
+    // Producer: func(size_t plane, T* dst, size_t offset, size_t count) fills one contiguous span
+    // of a plane with the source frames [offset, offset + count), and is called at most twice per plane.
+    template<class Func>
+    void write(size_t count, Func&& func)
+    {
+        assert(count <= capacity);
+
+        const size_t begin = writeIndex.load(std::memory_order_relaxed);
+
+        // announce the overwrite before touching the storage
+        reserveIndex.store(begin + count, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        const size_t head = begin & mask;
+        const size_t firstCount = std::min(count, capacity - head);
+        for (size_t plane = 0; plane < planeCount; ++plane)
+        {
+            T* planeData = data.data() + plane * capacity;
+            func(plane, planeData + head, 0, firstCount);
+            if (firstCount < count)
+            {
+                func(plane, planeData, firstCount, count - firstCount);
+            }
+        }
+
+        writeIndex.store(begin + count, std::memory_order_release);
+    }
+
+    // Consumer: total number of values written so far.
+    size_t writeCount()const
+    {
+        return writeIndex.load(std::memory_order_acquire);
+    }
+
+    // Consumer: copies the latest count values of every plane to dst[plane], oldest first, and
+    // returns the write count the copy corresponds to. Values not written yet read as zero.
+    size_t readLatest(T* const* dst, size_t count)const
+    {
+        assert(count <= capacity);
+
+        for (;;)
+        {
+            const size_t end = writeIndex.load(std::memory_order_acquire);
+            const size_t begin = end - count;
+
+            const size_t head = begin & mask;
+            const size_t firstCount = std::min(count, capacity - head);
+            for (size_t plane = 0; plane < planeCount; ++plane)
+            {
+                const T* planeData = data.data() + plane * capacity;
+                std::memcpy(dst[plane], planeData + head, firstCount * sizeof(T));
+                std::memcpy(dst[plane] + firstCount, planeData, (count - firstCount) * sizeof(T));
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (reserveIndex.load(std::memory_order_relaxed) <= begin + capacity)
+            {
+                return end;
+            }
+        }
+    }
+
+private:
+
+    std::vector<T> data;
+    size_t capacity = 0;
+    size_t mask = 0;
+    size_t planeCount = 1;
+
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> reserveIndex{0};
+};
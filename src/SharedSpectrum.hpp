@@ -0,0 +1,298 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <cstdint>
+#include <new>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+// The latest spectrum published in a named POSIX shared memory segment.
+//
+// The segment is a SharedSpectrumHeader followed by maxValues floats and maxLineBytes bytes
+// of UTF-8 text. The writer guards every update with a seqlock: sequence is odd while the
+// frame is being written and is increased to the next even number when it is complete,
+// so a reader that sees the same even sequence before and after reading has a consistent frame.
+// The writer never waits for readers, and readers need no system call after mapping the segment.
+//
+// This header is all a reader needs, see SharedSpectrumReader and spectrum_reader.cpp.
+struct SharedSpectrumHeader
+{
+    static constexpr std::uint32_t Version = 1;
+
+    char magic[4];                      // "MSAS"
+    std::uint32_t version;
+    std::uint32_t maxValues;
+    std::uint32_t maxLineBytes;
+    std::atomic<std::uint64_t> sequence;
+
+    // the fields below are only valid between two equal even sequence values
+    std::uint64_t frameIndex;
+    std::uint64_t timestampNs;          // system clock, nanoseconds since the UNIX epoch
+    std::uint32_t sampleRate;
+    std::uint32_t bandCount;
+    std::uint32_t rowCount;             // row after row, rowCount * bandCount values
+    std::uint32_t lineBytes;            // 0 if no rendered line is published
+
+    const float* values()const
+    {
+        return reinterpret_cast<const float*>(this + 1);
+    }
+
+    const char* line()const
+    {
+        return reinterpret_cast<const char*>(values() + maxValues);
+    }
+
+    static size_t SegmentSize(size_t maxValues, size_t maxLineBytes)
+    {
+        return sizeof(SharedSpectrumHeader) + maxValues * sizeof(float) + maxLineBytes;
+    }
+};
+
+static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "the seqlock must be lock-free to work across processes");
+
+#ifndef _WIN32
+
+// Creates the segment and publishes frames into it.
+class SharedSpectrumWriter
+{
+public:
+
+    SharedSpectrumWriter() = default;
+
+    SharedSpectrumWriter(const SharedSpectrumWriter&) = delete;
+    SharedSpectrumWriter& operator=(const SharedSpectrumWriter&) = delete;
+
+    ~SharedSpectrumWriter()
+    {
+        if (header)
+        {
+            munmap(header, segmentSize);
+            shm_unlink(name.c_str());
+        }
+    }
+
+    // name is a POSIX shared memory name such as "/analyzer"
+    bool open(const std::string& name, size_t maxValues, size_t maxLineBytes)
+    {
+        const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0)
+        {
+            std::cerr << "error: shm_open(\'" << name << "\') failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        const size_t size = SharedSpectrumHeader::SegmentSize(maxValues, maxLineBytes);
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            std::cerr << "error: ftruncate() of the shared memory failed: " << std::strerror(errno) << std::endl;
+            close(fd);
+            return false;
+        }
+
+        void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            std::cerr << "error: mmap() of the shared memory failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        this->name = name;
+        segmentSize = size;
+        header = new (p) SharedSpectrumHeader();
+        std::memcpy(header->magic, "MSAS", 4);
+        header->version = SharedSpectrumHeader::Version;
+        header->maxValues = static_cast<std::uint32_t>(maxValues);
+        header->maxLineBytes = static_cast<std::uint32_t>(maxLineBytes);
+        header->sequence.store(0, std::memory_order_release);
+
+        return true;
+    }
+
+    // Publishes the rows of one frame and, if not empty, the rendered text.
+    // Values and text that do not fit in the segment are cut off.
+    void write(const std::vector<const std::vector<float>*>& rows, int sampleRate, std::string_view line = {})
+    {
+        writeRows(rows.data(), rows.size(), sampleRate, line);
+    }
+
+    void write(const std::vector<float>& values, int sampleRate, std::string_view line = {})
+    {
+        const std::vector<float>* row = &values;
+        writeRows(&row, 1, sampleRate, line);
+    }
+
+private:
+
+    void writeRows(const std::vector<float>* const* rows, size_t rowCount, int sampleRate, std::string_view line)
+    {
+        const size_t bandCount = rowCount == 0 ? 0 : rows[0]->size();
+        rowCount = bandCount == 0 ? 0 : std::min<size_t>(rowCount, header->maxValues / bandCount);
+        const size_t lineBytes = std::min<size_t>(line.size(), header->maxLineBytes);
+
+        const std::uint64_t sequence = header->sequence.load(std::memory_order_relaxed);
+        header->sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        header->frameIndex = frameIndex++;
+        header->timestampNs = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        header->sampleRate = static_cast<std::uint32_t>(sampleRate);
+        header->bandCount = static_cast<std::uint32_t>(bandCount);
+        header->rowCount = static_cast<std::uint32_t>(rowCount);
+        header->lineBytes = static_cast<std::uint32_t>(lineBytes);
+
+        float* values = const_cast<float*>(header->values());
+        for (size_t rowIndex = 0; rowIndex < rowCount; ++rowIndex)
+        {
+            std::memcpy(values + rowIndex * bandCount, rows[rowIndex]->data(), bandCount * sizeof(float));
+        }
+        std::memcpy(const_cast<char*>(header->line()), line.data(), lineBytes);
+
+        header->sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    std::string name;
+    SharedSpectrumHeader* header = nullptr;
+    size_t segmentSize = 0;
+    std::uint64_t frameIndex = 0;
+};
+
+// Maps an existing segment read-only and takes consistent snapshots of it.
+class SharedSpectrumReader
+{
+public:
+
+    SharedSpectrumReader() = default;
+
+    SharedSpectrumReader(const SharedSpectrumReader&) = delete;
+    SharedSpectrumReader& operator=(const SharedSpectrumReader&) = delete;
+
+    ~SharedSpectrumReader()
+    {
+        if (header)
+        {
+            munmap(const_cast<SharedSpectrumHeader*>(header), segmentSize);
+        }
+    }
+
+    bool open(const std::string& name)
+    {
+        const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0)
+        {
+            std::cerr << "error: shm_open(\'" << name << "\') failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(SharedSpectrumHeader))
+        {
+            std::cerr << "error: \'" << name << "\' is not a spectrum segment" << std::endl;
+            close(fd);
+            return false;
+        }
+
+        void* p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED)
+        {
+            std::cerr << "error: mmap() of the shared memory failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        segmentSize = st.st_size;
+        header = static_cast<const SharedSpectrumHeader*>(p);
+
+        if (std::memcmp(header->magic, "MSAS", 4) != 0 || header->version != SharedSpectrumHeader::Version
+            || segmentSize < SharedSpectrumHeader::SegmentSize(header->maxValues, header->maxLineBytes))
+        {
+            std::cerr << "error: \'" << name << "\' is not a spectrum segment of version " << SharedSpectrumHeader::Version << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    // the sequence of the latest complete frame, to check cheaply whether a new one arrived
+    std::uint64_t sequence()const
+    {
+        return header->sequence.load(std::memory_order_acquire) & ~std::uint64_t(1);
+    }
+
+    // Calls func(const SharedSpectrumHeader&) on the frame in place, without copying it.
+    // func may see a frame that is being overwritten; the result is only valid if this returns true.
+    template<class Func>
+    bool view(Func&& func)const
+    {
+        const std::uint64_t before = header->sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            return false;
+        }
+
+        func(*header);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return header->sequence.load(std::memory_order_relaxed) == before;
+    }
+
+    // Copies the latest complete frame, retrying while it is being written.
+    // sequence receives the sequence of the copied frame, to compare with sequence() later.
+    // Returns false if no frame has been published yet.
+    bool read(std::vector<float>& values, std::string* line = nullptr, std::uint64_t* frameIndex = nullptr, std::uint32_t* bandCount = nullptr, std::uint64_t* sequence = nullptr)const
+    {
+        for (;;)
+        {
+            std::uint64_t frameSequence = 0;
+            const bool consistent = view([&](const SharedSpectrumHeader& frame)
+            {
+                const size_t count = std::min<size_t>(size_t(frame.rowCount) * frame.bandCount, frame.maxValues);
+                values.assign(frame.values(), frame.values() + count);
+                if (line)
+                {
+                    line->assign(frame.line(), std::min(frame.lineBytes, frame.maxLineBytes));
+                }
+                if (frameIndex)
+                {
+                    *frameIndex = frame.frameIndex;
+                }
+                if (bandCount)
+                {
+                    *bandCount = frame.bandCount;
+                }
+                frameSequence = frame.sequence.load(std::memory_order_relaxed);
+            });
+
+            if (consistent)
+            {
+                if (sequence)
+                {
+                    *sequence = frameSequence;
+                }
+                return frameSequence != 0;
+            }
+        }
+    }
+
+private:
+
+    const SharedSpectrumHeader* header = nullptr;
+    size_t segmentSize = 0;
+};
+
+#endif
@@ -0,0 +1,244 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "BandPlan.hpp"
+
+// Tracks a fixed set of frequencies with a sliding DFT instead of an FFT of the whole window.
+//
+// Every new sample updates three resonators per tracked frequency, one at the frequency and one
+// a DFT bin (samplingFrequency / windowSize) to either side, which combine into the Hann-windowed
+// DFT of the latest windowSize samples. A frame costs O(new samples * tracked frequencies),
+// however long the window is, and its spectrum includes the very latest sample.
+//
+// spectrum() follows SpectrumAnalyzer::spectrum(): bandCount values on the logarithmic frequency
+// axis, 0 at the bottom level and 1 at the top. Each tracked frequency fills the band it falls in,
+// the other bands stay 0, so Renderer draws the tracked frequencies as isolated bars.
+class SlidingDftAnalyzer
+{
+public:
+
+    SlidingDftAnalyzer(const std::vector<float>& trackedFrequencies, size_t windowSampleSize, size_t bandCount, int samplingFrequency)
+        : frequencies(trackedFrequencies)
+        , windowSize(std::max<size_t>(1, windowSampleSize))
+        , bandCount(bandCount)
+    {
+        const double pi = 3.14159265358979323846;
+        const double binStep = 2.0 * pi / windowSize;
+
+        const size_t count = frequencies.size() * 3;
+        coefRe.resize(count);
+        coefIm.resize(count);
+        coefNRe.resize(count);
+        coefNIm.resize(count);
+        stateRe.assign(count, 0.0);
+        stateIm.assign(count, 0.0);
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            // z = exp(-j theta), and z^N removes the sample that leaves the window
+            const double theta = 2.0 * pi * frequencies[i / 3] / samplingFrequency + binStep * (static_cast<double>(i % 3) - 1.0);
+            coefRe[i] = std::cos(theta);
+            coefIm[i] = -std::sin(theta);
+            coefNRe[i] = std::cos(theta * windowSize);
+            coefNIm[i] = -std::sin(theta * windowSize);
+        }
+
+        history.assign(windowSize, 0.0f);
+        levels.resize(frequencies.size());
+
+        // a full-scale sine at 1 kHz through a rectangular window, the same reference as SpectrumAnalyzer
+        zeroLevel = 10.0f * std::log10(BandPlan::DWeighting(1000.0f));
+    }
+
+    // Feeds the samples read since the previous call, readCount being the total number of samples
+    // read by the capturer, and updates the spectrum of every view.
+    // If more samples arrived than buffer holds, the window goes on with the latest samples it still holds.
+    void update(const std::vector<float>& buffer, size_t headIndex, size_t readCount, float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        size_t newCount = readCount - lastReadCount;
+        if (readCount < lastReadCount)
+        {
+            // the capturer started over
+            reset();
+            newCount = readCount;
+        }
+        newCount = std::min(newCount, buffer.size());
+        lastReadCount = readCount;
+
+        // the latest newCount samples, in up to two contiguous spans
+        const size_t bufferCount = buffer.size();
+        const size_t startIndex = (headIndex + bufferCount - newCount) % std::max<size_t>(1, bufferCount);
+        const size_t firstCount = std::min(newCount, bufferCount - startIndex);
+        feed(buffer.data() + startIndex, firstCount);
+        feed(buffer.data(), newCount - firstCount);
+
+        updateLevels();
+
+        mainView.minLevel = minLevel;
+        mainView.maxLevel = maxLevel;
+        mainView.freqMin = freqMin;
+        mainView.freqMax = freqMax;
+        mainView.logBase = logBase;
+        applyView(mainView);
+
+        for (auto& view : views)
+        {
+            applyView(view);
+        }
+    }
+
+    // see SpectrumAnalyzer::addView()
+    size_t addView(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        views.push_back(View{minLevel, maxLevel, freqMin, freqMax, logBase});
+        return views.size();
+    }
+
+    const std::vector<float>& spectrum(size_t view = 0)const
+    {
+        return view == 0 ? mainView.spectrum : views[view - 1].spectrum;
+    }
+
+    size_t viewCount()const
+    {
+        return views.size() + 1;
+    }
+
+    // the D-weighted level in dB of each tracked frequency, as of the last update()
+    const std::vector<float>& trackedLevels()const
+    {
+        return levels;
+    }
+
+private:
+
+    struct View
+    {
+        float minLevel = 0.0f;
+        float maxLevel = 0.0f;
+        float freqMin = 0.0f;
+        float freqMax = 0.0f;
+        float logBase = 0.0f;
+
+        // the band of each tracked frequency for the parameters above, bandCount if off the axis
+        std::vector<std::uint32_t> bands;
+        float builtFreqMin = 0.0f;
+        float builtFreqMax = 0.0f;
+        float builtLogBase = 0.0f;
+
+        std::vector<float> spectrum;
+    };
+
+    void reset()
+    {
+        std::fill(stateRe.begin(), stateRe.end(), 0.0);
+        std::fill(stateIm.begin(), stateIm.end(), 0.0);
+        std::fill(history.begin(), history.end(), 0.0f);
+        historyIndex = 0;
+    }
+
+    // X(n) = x(n) + z X(n-1) - z^N x(n-N); the state is kept in double so that the
+    // rounding errors of the endless recursion stay far below the displayed range
+    void feed(const float* samples, size_t count)
+    {
+        const size_t resonatorCount = stateRe.size();
+
+        for (size_t n = 0; n < count; ++n)
+        {
+            const double x = samples[n];
+            const double leaving = history[historyIndex];
+            history[historyIndex] = samples[n];
+            historyIndex = historyIndex + 1 == windowSize ? 0 : historyIndex + 1;
+
+            for (size_t i = 0; i < resonatorCount; ++i)
+            {
+                const double re = x - coefNRe[i] * leaving + coefRe[i] * stateRe[i] - coefIm[i] * stateIm[i];
+                const double im = -coefNIm[i] * leaving + coefRe[i] * stateIm[i] + coefIm[i] * stateRe[i];
+                stateRe[i] = re;
+                stateIm[i] = im;
+            }
+        }
+    }
+
+    // D-weighted level of each tracked frequency, in the dB of magnitude SpectrumAnalyzer uses
+    void updateLevels()
+    {
+        const double normalizeCoef = 2.0 / windowSize;
+
+        for (size_t i = 0; i < frequencies.size(); ++i)
+        {
+            // the Hann window 0.5 - 0.5 cos(2 pi n / N) in the frequency domain
+            const double re = 0.5 * stateRe[i * 3 + 1] - 0.25 * (stateRe[i * 3] + stateRe[i * 3 + 2]);
+            const double im = 0.5 * stateIm[i * 3 + 1] - 0.25 * (stateIm[i * 3] + stateIm[i * 3 + 2]);
+            const double magnitude = normalizeCoef * std::sqrt(re * re + im * im);
+
+            levels[i] = 10.0f * std::log10(BandPlan::DWeighting(frequencies[i]) * static_cast<float>(magnitude));
+        }
+    }
+
+    void applyView(View& view)
+    {
+        if (view.bands.size() != frequencies.size() || view.builtFreqMin != view.freqMin || view.builtFreqMax != view.freqMax || view.builtLogBase != view.logBase)
+        {
+            buildBands(view);
+        }
+
+        const float bottomLevel = zeroLevel + view.minLevel;
+        const float invRange = 1.0f / (view.maxLevel - view.minLevel);
+
+        view.spectrum.assign(bandCount, 0.0f);
+        for (size_t i = 0; i < frequencies.size(); ++i)
+        {
+            if (view.bands[i] < bandCount)
+            {
+                const float loudness = std::max(0.0f, levels[i] - bottomLevel) * invRange;
+                view.spectrum[view.bands[i]] = std::max(view.spectrum[view.bands[i]], loudness);
+            }
+        }
+    }
+
+    void buildBands(View& view)const
+    {
+        const float logFreqMin = std::pow(view.freqMin, 1.0f / view.logBase);
+        const float logFreqMax = std::pow(view.freqMax, 1.0f / view.logBase);
+
+        view.bands.resize(frequencies.size());
+        for (size_t i = 0; i < frequencies.size(); ++i)
+        {
+            const float freq = frequencies[i];
+            const float t = (std::pow(freq, 1.0f / view.logBase) - logFreqMin) / (logFreqMax - logFreqMin);
+            view.bands[i] = freq < view.freqMin || view.freqMax < freq
+                ? static_cast<std::uint32_t>(bandCount)
+                : static_cast<std::uint32_t>(std::min(bandCount - 1, static_cast<size_t>(t * bandCount)));
+        }
+
+        view.builtFreqMin = view.freqMin;
+        view.builtFreqMax = view.freqMax;
+        view.builtLogBase = view.logBase;
+    }
+
+    std::vector<float> frequencies;
+    size_t windowSize = 0;
+    size_t bandCount = 0;
+    float zeroLevel = 0.0f;
+
+    // three resonators per tracked frequency, at -1, 0 and +1 bin
+    std::vector<double> coefRe;
+    std::vector<double> coefIm;
+    std::vector<double> coefNRe;
+    std::vector<double> coefNIm;
+    std::vector<double> stateRe;
+    std::vector<double> stateIm;
+
+    std::vector<float> history;
+    size_t historyIndex = 0;
+    size_t lastReadCount = 0;
+
+    std::vector<float> levels;
+    View mainView;
+    std::vector<View> views;
+};
@@ -0,0 +1,278 @@
+#pragma once
+
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+enum class SignalType
+{
+    Sweep,
+    Multitone,
+    White,
+    Pink,
+    Silence,
+};
+
+// Generates a test signal instead of capturing an audio device, e.g. for soak tests on hosts without a sound server.
+//
+// In realtime the samples become available as the clock advances, like those of a device, and speed scales
+// that clock. Otherwise each update() generates one hop, like SoundCapturerStream, and the loop runs as
+// fast as it can. duration is the length of the signal in seconds, 0 generates forever.
+class SoundCapturerGenerator
+{
+public:
+
+    SoundCapturerGenerator() = default;
+
+    SoundCapturerGenerator(SignalType signal, int channels, float speed, float duration, bool realtime)
+        : signal(signal)
+        , channels(channels)
+        , speed(speed)
+        , duration(duration)
+        , realtime(realtime)
+    {}
+
+    bool init(size_t bufferSize, int samplingFrequency)
+    {
+        if (channels < 1)
+        {
+            std::cerr << "error: invalid channel count " << channels << std::endl;
+            return false;
+        }
+
+        sampleRate = samplingFrequency;
+        buffers.assign(channels, std::vector<float>(std::max<size_t>(1, bufferSize)));
+        hopSize = std::max<size_t>(1, sampleRate / 60);
+        totalCount = 0.0f < duration ? static_cast<size_t>(static_cast<double>(duration) * sampleRate) : SIZE_MAX;
+
+        // two octaves apart from 62.5 Hz, below the Nyquist frequency
+        tones.clear();
+        for (double freq = 62.5; freq < sampleRate / 2.0; freq *= 4.0)
+        {
+            tones.push_back({freq, 0.0});
+        }
+
+        // the noise of every channel is independent
+        noises.assign(channels, Noise());
+        for (int channel = 0; channel < channels; ++channel)
+        {
+            noises[channel].state = 0x9E3779B97F4A7C15ull * (channel + 1);
+        }
+
+        startTime = std::chrono::steady_clock::now();
+        latestTime = startTime;
+        return true;
+    }
+
+    // number of frames generated by each update() when not in realtime
+    void setHopSize(size_t frames)
+    {
+        hopSize = std::max<size_t>(1, frames);
+    }
+
+    void update()
+    {
+        if (!isOpen())
+        {
+            return;
+        }
+
+        size_t targetCount = realtime ? dueCount(std::chrono::steady_clock::now()) : readCount + hopSize;
+        targetCount = std::min(targetCount, totalCount);
+
+        // what would be overwritten within this update is skipped, so a stalled loop catches up at once
+        const size_t bufferCount = buffers[0].size();
+        if (readCount + bufferCount < targetCount)
+        {
+            readCount = targetCount - bufferCount;
+        }
+
+        for (; readCount < targetCount; ++readCount)
+        {
+            generate(readCount);
+            currentHeadIndex = currentHeadIndex + 1 == bufferCount ? 0 : currentHeadIndex + 1;
+        }
+
+        latestTime = realtime ? sampleTime(readCount) : std::chrono::steady_clock::now();
+    }
+
+    // in realtime, sleeps until minReadCount samples are due
+    void waitForSamples(size_t minReadCount, std::chrono::steady_clock::time_point deadline)
+    {
+        if (realtime && isOpen())
+        {
+            std::this_thread::sleep_until(std::min(deadline, sampleTime(std::min(minReadCount, totalCount))));
+        }
+    }
+
+    bool isOpen()const
+    {
+        return readCount < totalCount;
+    }
+
+    int samplingFrequency()const
+    {
+        return sampleRate;
+    }
+
+    size_t channelCount()const
+    {
+        return buffers.size();
+    }
+
+    const std::vector<float>& getBuffer(size_t channel = 0)const
+    {
+        return buffers[channel];
+    }
+
+    size_t bufferHeadIndex()const
+    {
+        return currentHeadIndex;
+    }
+
+    size_t bufferReadCount()const
+    {
+        return readCount;
+    }
+
+    // in realtime, when the latest sample was due
+    std::chrono::steady_clock::time_point latestSampleTime()const
+    {
+        return latestTime;
+    }
+
+    std::chrono::microseconds deviceLatency()const
+    {
+        return std::chrono::microseconds(0);
+    }
+
+private:
+
+    static constexpr double Pi = 3.14159265358979323846;
+    static constexpr float Amplitude = 0.5f;
+
+    // a logarithmic sweep from SweepMinFreq to 0.9 times the Nyquist frequency, repeated every SweepSeconds
+    static constexpr double SweepMinFreq = 20.0;
+    static constexpr double SweepSeconds = 10.0;
+
+    struct Tone
+    {
+        double freq;
+        double phase;
+    };
+
+    // xorshift64* white noise, and Paul Kellet's filter of it for pink noise
+    struct Noise
+    {
+        std::uint64_t state = 1;
+        float b[7] = {};
+
+        float white()
+        {
+            state ^= state >> 12;
+            state ^= state << 25;
+            state ^= state >> 27;
+            const std::uint64_t x = state * 0x2545F4914F6CDD1Dull;
+            return static_cast<float>(x >> 40) * (2.0f / 16777216.0f) - 1.0f;
+        }
+
+        float pink()
+        {
+            const float w = white();
+            b[0] = 0.99886f * b[0] + w * 0.0555179f;
+            b[1] = 0.99332f * b[1] + w * 0.0750759f;
+            b[2] = 0.96900f * b[2] + w * 0.1538520f;
+            b[3] = 0.86650f * b[3] + w * 0.3104856f;
+            b[4] = 0.55000f * b[4] + w * 0.5329522f;
+            b[5] = -0.7616f * b[5] - w * 0.0168980f;
+            const float y = b[0] + b[1] + b[2] + b[3] + b[4] + b[5] + b[6] + w * 0.5362f;
+            b[6] = w * 0.115926f;
+            return y * 0.11f;
+        }
+    };
+
+    size_t dueCount(std::chrono::steady_clock::time_point now)const
+    {
+        const std::chrono::duration<double> elapsed = now - startTime;
+        return static_cast<size_t>(elapsed.count() * speed * sampleRate);
+    }
+
+    std::chrono::steady_clock::time_point sampleTime(size_t count)const
+    {
+        return startTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(count / (static_cast<double>(speed) * sampleRate)));
+    }
+
+    // writes sample index of every channel at the head
+    void generate(size_t index)
+    {
+        switch (signal)
+        {
+        case SignalType::Sweep:
+        {
+            const double maxFreq = 0.45 * sampleRate;
+            const double t = std::fmod(index / static_cast<double>(sampleRate), SweepSeconds) / SweepSeconds;
+            const double freq = SweepMinFreq * std::pow(maxFreq / SweepMinFreq, t);
+            sweepPhase = std::fmod(sweepPhase + 2.0 * Pi * freq / sampleRate, 2.0 * Pi);
+            fill(Amplitude * static_cast<float>(std::sin(sweepPhase)));
+            break;
+        }
+        case SignalType::Multitone:
+        {
+            double sum = 0.0;
+            for (auto& tone : tones)
+            {
+                tone.phase = std::fmod(tone.phase + 2.0 * Pi * tone.freq / sampleRate, 2.0 * Pi);
+                sum += std::sin(tone.phase);
+            }
+            fill(Amplitude * static_cast<float>(sum / std::max<size_t>(1, tones.size())));
+            break;
+        }
+        case SignalType::White:
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                buffers[channel][currentHeadIndex] = Amplitude * noises[channel].white();
+            }
+            break;
+        case SignalType::Pink:
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                buffers[channel][currentHeadIndex] = Amplitude * noises[channel].pink();
+            }
+            break;
+        case SignalType::Silence:
+            fill(0.0f);
+            break;
+        }
+    }
+
+    void fill(float value)
+    {
+        for (auto& buffer : buffers)
+        {
+            buffer[currentHeadIndex] = value;
+        }
+    }
+
+    SignalType signal = SignalType::Sweep;
+    int channels = 2;
+    float speed = 1.0f;
+    float duration = 0.0f;
+    bool realtime = true;
+    int sampleRate = 48000;
+
+    size_t hopSize = 0;
+    size_t totalCount = 0;
+    double sweepPhase = 0.0;
+    std::vector<Tone> tones;
+    std::vector<Noise> noises;
+
+    std::vector<std::vector<float>> buffers;
+    size_t currentHeadIndex = 0;
+    size_t readCount = 0;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point latestTime;
+};
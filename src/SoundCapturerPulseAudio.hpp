@@ -5,75 +5,116 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
 
 #include <pulse/pulseaudio.h>
 #include <pulse/error.h>
 
+#include "RingBuffer.hpp"
+#include "SpectrumKernels.hpp"
+
+// Captures the monitor of the default sink on PulseAudio's own thread (pa_threaded_mainloop).
+// The read callback only appends to a lock-free ring buffer, and update() takes a consistent
+// snapshot of the latest samples from it, so capture keeps running while a frame is analyzed or drawn.
+// Every channel of the stream is deinterleaved into its own plane of the ring buffer.
+// The stream is requested as 32-bit float, with 16-bit PCM as the fallback.
+//
+// init() asks the server for the default sink first and, unless a sampling frequency is given, records
+// its monitor at the sink's own rate, and in 16-bit PCM if that is the sink's format, so that the server
+// converts nothing for the analyzer.
+//
+// After each read the stream latency (pa_stream_get_latency, the time from the capture of a sample
+// by the source to its read) dates the newest sample written to the ring buffer, which update()
+// carries over to the snapshot as latestSampleTime().
 class SoundCapturerPulseAudio
 {
 public:
 
     SoundCapturerPulseAudio() = default;
 
-    bool init(size_t bufferSize, int samplingFrequency)
+    explicit SoundCapturerPulseAudio(int channels)
+    {
+        data.ss.channels = static_cast<std::uint8_t>(channels);
+    }
+
+    // Asks the server for fragments of lowLatencyFragment instead of defaultFragment. Call before init().
+    void setLowLatency(bool enabled)
+    {
+        data.fragment = enabled ? lowLatencyFragment : defaultFragment;
+    }
+
+    ~SoundCapturerPulseAudio()
+    {
+        if (data.mainloop)
+        {
+            pa_threaded_mainloop_stop(data.mainloop);
+        }
+
+        if (data.stream)
+        {
+            pa_stream_disconnect(data.stream);
+            pa_stream_unref(data.stream);
+        }
+
+        if (context)
+        {
+            pa_context_disconnect(context);
+            pa_context_unref(context);
+        }
+
+        if (data.mainloop)
+        {
+            pa_threaded_mainloop_free(data.mainloop);
+        }
+    }
+
+    // bufferSize gives the samples per channel to keep at the sampling frequency of the stream.
+    // samplingFrequency 0 takes the rate of the default sink.
+    bool init(const std::function<size_t(int)>& bufferSize, int samplingFrequency)
     {
         const auto contextStateCallback = [](pa_context* context, void* userdata)
         {
-            const auto callback = [](pa_context* context, const pa_server_info* info, void* userdata)
+            static constexpr auto sinkCallback = [](pa_context* context, const pa_sink_info* info, int eol, void* userdata)
             {
                 auto pData = reinterpret_cast<UserData*>(userdata);
+                if (0 < eol)
+                {
+                    return;
+                }
 
-                pData->sinkName = std::string(info->default_sink_name) + std::string(".monitor");
-
-                const pa_buffer_attr recAttr = {
-                    .maxlength = static_cast<std::uint32_t>(-1),
-                    .tlength = static_cast<std::uint32_t>(-1),
-                    .minreq = static_cast<std::uint32_t>(-1),
-                    .fragsize = static_cast<std::uint32_t>(pa_usec_to_bytes(50 * PA_USEC_PER_MSEC, &pData->ss)),
-                };
+                if (eol < 0 || !info)
+                {
+                    std::cerr << "pa_context_get_sink_info_by_name() failed" << std::endl;
+                    pData->setNegotiated(false);
+                    return;
+                }
 
-                if (pa_stream_connect_record(pData->stream, pData->sinkName.c_str(), &recAttr, PA_STREAM_ADJUST_LATENCY) != 0)
+                if (pData->ss.rate == 0)
                 {
-                    std::cerr << "pa_stream_connect_record() failed" << std::endl;
+                    pData->ss.rate = info->sample_spec.rate;
                 }
+                pData->sinkRate = info->sample_spec.rate;
+                pData->ss.format = info->sample_spec.format == PA_SAMPLE_S16LE ? PA_SAMPLE_S16LE : PA_SAMPLE_FLOAT32LE;
+                pData->setNegotiated(true);
             };
 
-            const auto streamReadCallback = [](pa_stream* s, size_t bytesLength, void* userdata)
+            const auto serverCallback = [](pa_context* context, const pa_server_info* info, void* userdata)
             {
                 auto pData = reinterpret_cast<UserData*>(userdata);
-
-                while (pa_stream_readable_size(s) > 0)
+                if (!info || !info->default_sink_name)
                 {
-                    const void *data;
-                    if (pa_stream_peek(s, &data, &bytesLength) < 0)
-                    {
-                        std::cerr << "pa_stream_peek() failed" << std::endl;
-                        return;
-                    }
-
-                    assert(bytesLength % 4 == 0);
-
-                    if (pData->buffer.size() < bytesLength / 4)
-                    {
-                        pData->buffer.resize(bytesLength / 4);
-                    }
-
-                    if (data)
-                    {
-                        const size_t bufferCount = pData->buffer.size();
-                        const auto readData = static_cast<const std::int16_t*>(data);
-
-                        for (size_t i = 0; i < bytesLength / 2; i += 2)
-                        {
-                            pData->buffer[pData->bufferHeadIndex] = readData[i] / 32767.0f;
-                            ++pData->bufferHeadIndex;
-                            pData->bufferHeadIndex %= bufferCount;
-                        }
-                        pData->readCount += bytesLength / 2;
-                    }
-
-                    pa_stream_drop(s);
+                    std::cerr << "error: PulseAudio has no default sink" << std::endl;
+                    pData->setNegotiated(false);
+                    return;
                 }
+
+                pData->sinkName = std::string(info->default_sink_name) + std::string(".monitor");
+                pa_operation_unref(pa_context_get_sink_info_by_name(context, info->default_sink_name, sinkCallback, userdata));
             };
 
             auto pData = reinterpret_cast<UserData*>(userdata);
@@ -81,81 +122,286 @@ public:
             switch (pa_context_get_state(context))
             {
             case PA_CONTEXT_READY:
-            {
-                pData->stream = pa_stream_new(context, "minimal spectrum analyzer", &pData->ss, nullptr);
-                if (!pData->stream)
-                {
-                    std::cerr << "pa_stream_new() failed" << std::endl;
-                    return;
-                }
-
-                pa_operation_unref(pa_context_get_server_info(context, callback, userdata));
-                pa_stream_set_read_callback(pData->stream, streamReadCallback, userdata);
+                pa_operation_unref(pa_context_get_server_info(context, serverCallback, userdata));
                 break;
-            }
 
             case PA_CONTEXT_FAILED:
                 std::cerr << "error: PA_CONTEXT_FAILED" << std::endl;
+                // a server lost after startup closes the capturer, like PA_CONTEXT_TERMINATED;
+                // setNegotiated() wakes init() or waitForSamples(), whichever is waiting
+                pData->terminated = true;
+                pData->setNegotiated(false);
                 break;
 
             case PA_CONTEXT_TERMINATED:
-                pa_mainloop_quit(pData->mainloop, 0);
-                pData->mainloop = nullptr;
+                pData->terminated = true;
+                pData->notify();
                 break;
 
             default: break;
             }
         };
 
+        const auto streamReadCallback = [](pa_stream* s, size_t bytesLength, void* userdata)
+        {
+            auto pData = reinterpret_cast<UserData*>(userdata);
+
+            while (pa_stream_readable_size(s) > 0)
+            {
+                const void *data;
+                if (pa_stream_peek(s, &data, &bytesLength) < 0)
+                {
+                    std::cerr << "pa_stream_peek() failed" << std::endl;
+                    return;
+                }
+
+                const size_t channels = pData->ss.channels;
+                const size_t frameBytes = pa_frame_size(&pData->ss);
+                assert(bytesLength % frameBytes == 0);
+
+                if (data)
+                {
+                    const size_t frameCount = std::min(bytesLength / frameBytes, pData->ring.size());
+                    const size_t skipCount = bytesLength / frameBytes - frameCount;
+
+                    // each span of the ring is filled straight from the stream's buffer
+                    if (pData->ss.format == PA_SAMPLE_FLOAT32LE)
+                    {
+                        const auto readData = static_cast<const float*>(data) + skipCount * channels;
+                        pData->ring.write(frameCount, [&](size_t channel, float* dst, size_t offset, size_t count)
+                        {
+                            const float* src = readData + offset * channels + channel;
+                            for (size_t i = 0; i < count; ++i)
+                            {
+                                dst[i] = src[i * channels];
+                            }
+                        });
+                    }
+                    else
+                    {
+                        const auto readData = static_cast<const std::int16_t*>(data) + skipCount * channels;
+                        pData->ring.write(frameCount, [&](size_t channel, float* dst, size_t offset, size_t count)
+                        {
+                            SpectrumKernels::S16ToFloat(readData + offset * channels + channel, channels, dst, count);
+                        });
+                    }
+                }
+
+                pa_stream_drop(s);
+            }
+
+            // everything readable has been read, so the latency is the age of the newest sample
+            pa_usec_t latency = 0;
+            int negative = 0;
+            if (pa_stream_get_latency(s, &latency, &negative) == 0)
+            {
+                const pa_timing_info* timing = pa_stream_get_timing_info(s);
+                const pa_usec_t deviceLatency = timing ? timing->source_usec + timing->transport_usec : 0;
+                pData->setAnchor(std::chrono::steady_clock::now() - std::chrono::microseconds(negative ? 0 : latency), std::chrono::microseconds(deviceLatency));
+            }
+
+            pData->notify();
+        };
+
         data.ss.rate = static_cast<std::uint32_t>(samplingFrequency);
 
         const std::string appName = std::string("minimal spectrum analyzer");
 
-        pa_mainloop_api* mainloop_api = pa_mainloop_get_api(data.mainloop);
+        data.mainloop = pa_threaded_mainloop_new();
+        if (!data.mainloop)
+        {
+            std::cerr << "pa_threaded_mainloop_new() failed" << std::endl;
+            return false;
+        }
 
-        pa_context* context = pa_context_new(mainloop_api, appName.c_str());
+        pa_mainloop_api* mainloop_api = pa_threaded_mainloop_get_api(data.mainloop);
 
-        pa_context_connect(context, nullptr, PA_CONTEXT_NOFLAGS, nullptr);
+        context = pa_context_new(mainloop_api, appName.c_str());
 
         pa_context_set_state_callback(context, contextStateCallback, static_cast<void*>(&data));
 
-        pa_mainloop_iterate(data.mainloop, 0, nullptr);
+        pa_context_connect(context, nullptr, PA_CONTEXT_NOFLAGS, nullptr);
+
+        if (pa_threaded_mainloop_start(data.mainloop) < 0)
+        {
+            std::cerr << "pa_threaded_mainloop_start() failed" << std::endl;
+            return false;
+        }
+
+        // the format of the stream follows the sink, so nothing is read before the server has told it
+        if (!data.waitNegotiated(negotiationTimeout))
+        {
+            std::cerr << "error: cannot query the default sink of PulseAudio" << std::endl;
+            return false;
+        }
+
+        if (data.ss.rate != data.sinkRate)
+        {
+            std::cerr << "warning: the default sink runs at " << data.sinkRate << " Hz, so the server resamples its monitor to " << data.ss.rate << " Hz. omit --sample_rate to capture at the sink's rate." << std::endl;
+        }
+
+        const size_t size = bufferSize(static_cast<int>(data.ss.rate));
+
+        // one second of slack, so that the snapshot is rarely overwritten while it is copied
+        data.ring.init(size + data.ss.rate, data.ss.channels);
+
+        buffers.resize(data.ss.channels);
+        bufferPointers.resize(data.ss.channels);
+        for (size_t channel = 0; channel < buffers.size(); ++channel)
+        {
+            buffers[channel].resize(size);
+            bufferPointers[channel] = buffers[channel].data();
+        }
+
+        pa_threaded_mainloop_lock(data.mainloop);
+
+        // a server that cannot provide the format of the sink gets 16-bit PCM
+        data.stream = pa_stream_new(context, "minimal spectrum analyzer", &data.ss, nullptr);
+        if (!data.stream && data.ss.format != PA_SAMPLE_S16LE)
+        {
+            data.ss.format = PA_SAMPLE_S16LE;
+            data.stream = pa_stream_new(context, "minimal spectrum analyzer", &data.ss, nullptr);
+        }
+
+        bool connected = false;
+        if (!data.stream)
+        {
+            std::cerr << "pa_stream_new() failed" << std::endl;
+        }
+        else
+        {
+            pa_stream_set_read_callback(data.stream, streamReadCallback, &data);
 
-        data.buffer.resize(bufferSize);
+            const pa_buffer_attr recAttr = {
+                .maxlength = static_cast<std::uint32_t>(-1),
+                .tlength = static_cast<std::uint32_t>(-1),
+                .minreq = static_cast<std::uint32_t>(-1),
+                .fragsize = static_cast<std::uint32_t>(pa_usec_to_bytes(data.fragment, &data.ss)),
+            };
 
-        return true;
+            // the timing flags keep pa_stream_get_latency() up to date without explicit requests
+            const auto flags = static_cast<pa_stream_flags_t>(PA_STREAM_ADJUST_LATENCY | PA_STREAM_INTERPOLATE_TIMING | PA_STREAM_AUTO_TIMING_UPDATE);
+            connected = pa_stream_connect_record(data.stream, data.sinkName.c_str(), &recAttr, flags) == 0;
+            if (!connected)
+            {
+                std::cerr << "pa_stream_connect_record() failed" << std::endl;
+            }
+        }
+
+        pa_threaded_mainloop_unlock(data.mainloop);
+
+        return connected;
+    }
+
+    // the rate of the stream, decided by init()
+    int samplingFrequency()const
+    {
+        return static_cast<int>(data.ss.rate);
     }
 
     void update()
     {
-        if (data.mainloop)
+        readCount = data.ring.readLatest(bufferPointers.data(), buffers[0].size());
+
+        // the anchor dates the sample at its write count, the rate dates the others
+        std::lock_guard<std::mutex> lock(data.mutex);
+        const double offset = (static_cast<double>(readCount) - static_cast<double>(data.anchorCount)) / data.ss.rate;
+        latestTime = data.anchorTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(offset));
+    }
+
+    void waitForSamples(size_t minReadCount, std::chrono::steady_clock::time_point deadline)
+    {
+        std::unique_lock<std::mutex> lock(data.mutex);
+        data.dataArrived.wait_until(lock, deadline, [&]
         {
-            pa_mainloop_iterate(data.mainloop, 0, nullptr);
-        }
+            return minReadCount <= data.ring.writeCount() || data.terminated;
+        });
     }
 
-    const std::vector<float>& getBuffer()const
+    bool isOpen()const
     {
-        return data.buffer;
+        return !data.terminated;
     }
 
+    size_t channelCount()const
+    {
+        return buffers.size();
+    }
+
+    const std::vector<float>& getBuffer(size_t channel = 0)const
+    {
+        return buffers[channel];
+    }
+
+    // the snapshot is stored oldest first
     size_t bufferHeadIndex()const
     {
-        return data.bufferHeadIndex;
+        return 0;
     }
 
     size_t bufferReadCount()const
     {
-        return data.readCount;
+        return readCount;
+    }
+
+    // when the newest sample of the snapshot was captured by the source
+    std::chrono::steady_clock::time_point latestSampleTime()const
+    {
+        return latestTime;
+    }
+
+    // the part of the latency spent in the source and on the way to the server
+    std::chrono::microseconds deviceLatency()const
+    {
+        std::lock_guard<std::mutex> lock(data.mutex);
+        return data.deviceLatency;
     }
 
 private:
 
+    static constexpr pa_usec_t defaultFragment = 50 * PA_USEC_PER_MSEC;
+    static constexpr pa_usec_t lowLatencyFragment = 5 * PA_USEC_PER_MSEC;
+    static constexpr std::chrono::seconds negotiationTimeout{5};
+
     struct UserData
     {
-        UserData()
-            : mainloop(pa_mainloop_new())
-        {}
+        void notify()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+            }
+            dataArrived.notify_one();
+        }
+
+        // called once the server has answered for the default sink, or failed to
+        void setNegotiated(bool succeeded)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                negotiated = succeeded;
+                negotiationFailed = !succeeded;
+            }
+            dataArrived.notify_one();
+        }
+
+        bool waitNegotiated(std::chrono::seconds timeout)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            dataArrived.wait_for(lock, timeout, [&]
+            {
+                return negotiated || negotiationFailed;
+            });
+            return negotiated;
+        }
+
+        // called after a read, with the time the newest sample written to the ring was captured
+        void setAnchor(std::chrono::steady_clock::time_point time, std::chrono::microseconds device)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            anchorCount = ring.writeCount();
+            anchorTime = time;
+            deviceLatency = device;
+        }
 
         pa_sample_spec ss = {
             .format = PA_SAMPLE_S16LE,
@@ -164,15 +410,32 @@ private:
         };
 
         std::string sinkName;
-        std::vector<float> buffer;
-        size_t bufferHeadIndex = 0;
-        size_t readCount = 0;
+        std::uint32_t sinkRate = 0;
+        SPSCRingBuffer<float> ring;
+        std::atomic<bool> terminated{false};
+        mutable std::mutex mutex;
+        std::condition_variable dataArrived;
+
+        pa_usec_t fragment = defaultFragment;
+
+        // guarded by mutex
+        bool negotiated = false;
+        bool negotiationFailed = false;
+        size_t anchorCount = 0;
+        std::chrono::steady_clock::time_point anchorTime = std::chrono::steady_clock::now();
+        std::chrono::microseconds deviceLatency{0};
 
         pa_stream* stream = nullptr;
-        pa_mainloop* mainloop = nullptr;
+        pa_threaded_mainloop* mainloop = nullptr;
     };
 
     UserData data;
+    pa_context* context = nullptr;
+
+    std::vector<std::vector<float>> buffers;
+    std::vector<float*> bufferPointers;
+    size_t readCount = 0;
+    std::chrono::steady_clock::time_point latestTime = std::chrono::steady_clock::now();
 };
 
 #endif
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+
+#include "CaptureRecorder.hpp"
+
+// Plays a recording of --record back as a capturer.
+//
+// Each update() applies the next block: its samples enter the ring buffers and the read count and
+// capture time become the recorded ones. Every block was one frame when it was recorded, so with the
+// same options the analyzer sees the same samples at the same frames and draws the same output.
+// With realtime pacing the blocks are released at their recorded frame times, otherwise at once.
+class SoundCapturerReplay
+{
+public:
+
+    SoundCapturerReplay() = default;
+
+    SoundCapturerReplay(const std::string& path, bool realtime)
+        : path(path)
+        , realtime(realtime)
+    {}
+
+    SoundCapturerReplay(const SoundCapturerReplay&) = delete;
+    SoundCapturerReplay& operator=(const SoundCapturerReplay&) = delete;
+
+    ~SoundCapturerReplay()
+    {
+        if (file)
+        {
+            std::fclose(file);
+        }
+    }
+
+    // The ring buffers take the size the recording was made with, so that the frames drop and skip
+    // the same samples as when they were recorded.
+    bool init()
+    {
+        file = std::fopen(path.c_str(), "rb");
+        if (!file)
+        {
+            std::cerr << "error: cannot open \'" << path << "\': " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        RecordingHeader header;
+        if (std::fread(&header, sizeof(header), 1, file) != 1 || std::memcmp(header.magic, "MSAR", 4) != 0 || header.version != 1)
+        {
+            std::cerr << "error: \'" << path << "\' is not a recording of --record." << std::endl;
+            return false;
+        }
+
+        if (header.channels < 1 || header.sampleRate < 1 || header.bufferSize < 1)
+        {
+            std::cerr << "error: \'" << path << "\' has an invalid header." << std::endl;
+            return false;
+        }
+
+        sampleRate = static_cast<int>(header.sampleRate);
+        buffers.assign(header.channels, std::vector<float>(static_cast<size_t>(header.bufferSize)));
+
+        startTime = std::chrono::steady_clock::now();
+        latestTime = startTime;
+        open = readBlock();
+        return true;
+    }
+
+    void update()
+    {
+        if (!open)
+        {
+            lastBlockApplied = false;
+            return;
+        }
+
+        const size_t channels = buffers.size();
+        const size_t bufferCount = buffers[0].size();
+
+        // a block longer than the buffer only leaves its latest samples
+        const size_t skipCount = block.sampleCount - std::min<size_t>(block.sampleCount, bufferCount);
+        for (size_t i = skipCount; i < block.sampleCount; ++i)
+        {
+            for (size_t channel = 0; channel < channels; ++channel)
+            {
+                buffers[channel][currentHeadIndex] = interleaved[i * channels + channel];
+            }
+            currentHeadIndex = currentHeadIndex + 1 == bufferCount ? 0 : currentHeadIndex + 1;
+        }
+
+        readCount = block.readCount;
+        latestTime = startTime + std::chrono::nanoseconds(block.captureTimeNs);
+        device = std::chrono::microseconds(block.deviceLatencyUs);
+
+        open = readBlock();
+        lastBlockApplied = !open;
+    }
+
+    // with realtime pacing, waits for the recorded frame time of the next block
+    void waitForSamples(size_t, std::chrono::steady_clock::time_point deadline)
+    {
+        if (realtime && open)
+        {
+            std::this_thread::sleep_until(std::min(deadline, startTime + std::chrono::nanoseconds(block.frameTimeNs)));
+        }
+    }
+
+    // the last block is still drawn after the end of the file has been read ahead,
+    // the next update() closes the capturer
+    bool isOpen()const
+    {
+        return open || lastBlockApplied;
+    }
+
+    int samplingFrequency()const
+    {
+        return sampleRate;
+    }
+
+    size_t channelCount()const
+    {
+        return buffers.size();
+    }
+
+    const std::vector<float>& getBuffer(size_t channel = 0)const
+    {
+        return buffers[channel];
+    }
+
+    size_t bufferHeadIndex()const
+    {
+        return currentHeadIndex;
+    }
+
+    size_t bufferReadCount()const
+    {
+        return readCount;
+    }
+
+    // the recorded capture time, shifted to the start of the replay
+    std::chrono::steady_clock::time_point latestSampleTime()const
+    {
+        return latestTime;
+    }
+
+    std::chrono::microseconds deviceLatency()const
+    {
+        return device;
+    }
+
+private:
+
+    // reads the next block ahead, so that its frame time is known before it is due
+    bool readBlock()
+    {
+        if (std::fread(&block, sizeof(block), 1, file) != 1)
+        {
+            return false;
+        }
+
+        interleaved.resize(static_cast<size_t>(block.sampleCount) * buffers.size());
+        if (std::fread(interleaved.data(), sizeof(float), interleaved.size(), file) != interleaved.size())
+        {
+            std::cerr << "error: \'" << path << "\' is truncated." << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+
+    std::string path;
+    bool realtime = true;
+    std::FILE* file = nullptr;
+    int sampleRate = 0;
+
+    RecordingBlock block{};
+    std::vector<float> interleaved;
+    bool open = false;
+    bool lastBlockApplied = false;
+
+    std::vector<std::vector<float>> buffers;
+    size_t currentHeadIndex = 0;
+    size_t readCount = 0;
+    std::chrono::steady_clock::time_point startTime;
+    std::chrono::steady_clock::time_point latestTime;
+    std::chrono::microseconds device{0};
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+enum class StreamFormat
+{
+    S16LE,
+    F32LE,
+    Wav,
+};
+
+// Reads interleaved PCM from stdin (a pipe or a redirected file) instead of an audio device.
+// Each update() blocks until one hop of frames has been read and deinterleaves it into one buffer per channel.
+class SoundCapturerStream
+{
+public:
+
+    SoundCapturerStream() = default;
+
+    SoundCapturerStream(StreamFormat format, int channels)
+        : format(format)
+        , sampleFormat(format == StreamFormat::Wav ? StreamFormat::S16LE : format)
+        , channels(channels)
+    {}
+
+    bool init(size_t bufferSize, int samplingFrequency)
+    {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        file = stdin;
+        sampleRate = samplingFrequency;
+
+        if (format == StreamFormat::Wav && !readWavHeader())
+        {
+            return false;
+        }
+
+        if (channels < 1)
+        {
+            std::cerr << "error: invalid channel count " << channels << std::endl;
+            return false;
+        }
+
+        buffers.assign(channels, std::vector<float>(bufferSize));
+        hopSize = std::max<size_t>(1, sampleRate / 60);
+        open = true;
+
+        return true;
+    }
+
+    // number of frames read by each update()
+    void setHopSize(size_t frames)
+    {
+        hopSize = std::max<size_t>(1, frames);
+    }
+
+    void update()
+    {
+        if (!open)
+        {
+            return;
+        }
+
+        const size_t frameBytes = sampleBytes() * channels;
+        readBuffer.resize(hopSize * frameBytes);
+
+        // a WAVE stream ends with its data chunk, whatever follows it is not PCM
+        const size_t readSize = static_cast<size_t>(std::min<std::uint64_t>(readBuffer.size(), dataRemaining / frameBytes * frameBytes));
+        const size_t bytesRead = std::fread(readBuffer.data(), 1, readSize, file);
+        if (dataRemaining != UnknownSize)
+        {
+            dataRemaining -= bytesRead;
+        }
+        const size_t framesRead = bytesRead / frameBytes;
+
+        const size_t bufferCount = buffers[0].size();
+        for (size_t i = 0; i < framesRead; ++i)
+        {
+            const std::uint8_t* frame = readBuffer.data() + i * frameBytes;
+            for (int channel = 0; channel < channels; ++channel)
+            {
+                buffers[channel][currentHeadIndex] = readSample(frame + channel * sampleBytes());
+            }
+            ++currentHeadIndex;
+            currentHeadIndex %= bufferCount;
+        }
+        readCount += framesRead;
+        latestTime = std::chrono::steady_clock::now();
+
+        if (bytesRead < readBuffer.size())
+        {
+            open = false;
+        }
+    }
+
+    // update() blocks on the stream itself, so there is nothing to wait for here
+    void waitForSamples(size_t minReadCount, std::chrono::steady_clock::time_point deadline)
+    {
+    }
+
+    bool isOpen()const
+    {
+        return open;
+    }
+
+    int samplingFrequency()const
+    {
+        return sampleRate;
+    }
+
+    size_t channelCount()const
+    {
+        return buffers.size();
+    }
+
+    const std::vector<float>& getBuffer(size_t channel = 0)const
+    {
+        return buffers[channel];
+    }
+
+    size_t bufferHeadIndex()const
+    {
+        return currentHeadIndex;
+    }
+
+    size_t bufferReadCount()const
+    {
+        return readCount;
+    }
+
+    // a stream has no capture clock, so its samples are dated by their read
+    std::chrono::steady_clock::time_point latestSampleTime()const
+    {
+        return latestTime;
+    }
+
+    std::chrono::microseconds deviceLatency()const
+    {
+        return std::chrono::microseconds(0);
+    }
+
+private:
+
+    size_t sampleBytes()const
+    {
+        return sampleFormat == StreamFormat::S16LE ? 2 : 4;
+    }
+
+    float readSample(const std::uint8_t* p)const
+    {
+        if (sampleFormat == StreamFormat::S16LE)
+        {
+            const std::int16_t x = static_cast<std::int16_t>(p[0] | (p[1] << 8));
+            return x / 32767.0f;
+        }
+
+        float x;
+        std::memcpy(&x, p, sizeof(x));
+        return x;
+    }
+
+    bool readBytes(void* dst, size_t size)
+    {
+        return std::fread(dst, 1, size, file) == size;
+    }
+
+    // stdin may be a pipe, so a chunk is skipped by reading it, a piece at a time
+    bool skipBytes(std::uint64_t size)
+    {
+        std::uint8_t piece[4096];
+        while (0 < size)
+        {
+            const size_t pieceSize = static_cast<size_t>(std::min<std::uint64_t>(size, sizeof(piece)));
+            if (!readBytes(piece, pieceSize))
+            {
+                return false;
+            }
+            size -= pieceSize;
+        }
+        return true;
+    }
+
+    static std::uint32_t ReadU32(const std::uint8_t* p)
+    {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<std::uint32_t>(p[3]) << 24);
+    }
+
+    static std::uint16_t ReadU16(const std::uint8_t* p)
+    {
+        return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    // Reads the chunks up to the data chunk. Every chunk must fit in the RIFF size, and data stops
+    // update() at its end. Streaming writers that cannot know the sizes leave them at 0 or 0xFFFFFFFF;
+    // then the chunks are only bounded by the stream and data lasts until its end.
+    bool readWavHeader()
+    {
+        std::uint8_t riff[12];
+        if (!readBytes(riff, sizeof(riff)) || std::memcmp(riff, "RIFF", 4) != 0 || std::memcmp(riff + 8, "WAVE", 4) != 0)
+        {
+            std::cerr << "error: input is not a RIFF/WAVE stream" << std::endl;
+            return false;
+        }
+
+        const std::uint32_t riffSize = ReadU32(riff + 4);
+        std::uint64_t riffRemaining = riffSize == 0 || riffSize == 0xFFFFFFFF ? UnknownSize : std::max<std::uint32_t>(riffSize, 4) - 4;
+
+        bool hasFormat = false;
+        for (;;)
+        {
+            std::uint8_t chunk[8];
+            if (riffRemaining < sizeof(chunk) || !readBytes(chunk, sizeof(chunk)))
+            {
+                std::cerr << "error: WAVE stream has no data chunk" << std::endl;
+                return false;
+            }
+            if (riffRemaining != UnknownSize)
+            {
+                riffRemaining -= sizeof(chunk);
+            }
+
+            const std::uint32_t chunkSize = ReadU32(chunk + 4);
+            const std::uint64_t paddedSize = static_cast<std::uint64_t>(chunkSize) + (chunkSize & 1);
+
+            if (std::memcmp(chunk, "data", 4) == 0)
+            {
+                if (!hasFormat)
+                {
+                    std::cerr << "error: WAVE data chunk precedes the fmt chunk" << std::endl;
+                    return false;
+                }
+
+                dataRemaining = chunkSize == 0 || chunkSize == 0xFFFFFFFF ? riffRemaining : std::min<std::uint64_t>(chunkSize, riffRemaining);
+                return true;
+            }
+
+            if (riffRemaining < paddedSize)
+            {
+                std::cerr << "error: WAVE chunk of " << chunkSize << " bytes exceeds the RIFF size" << std::endl;
+                return false;
+            }
+            if (riffRemaining != UnknownSize)
+            {
+                riffRemaining -= paddedSize;
+            }
+
+            // only the fmt chunk is read, up to the sub-format of WAVE_FORMAT_EXTENSIBLE
+            std::uint8_t body[26] = {};
+            const size_t bodySize = std::memcmp(chunk, "fmt ", 4) == 0 ? std::min<size_t>(chunkSize, sizeof(body)) : 0;
+            if (!readBytes(body, bodySize) || !skipBytes(paddedSize - bodySize))
+            {
+                std::cerr << "error: truncated WAVE header" << std::endl;
+                return false;
+            }
+
+            if (std::memcmp(chunk, "fmt ", 4) == 0 && 16 <= chunkSize)
+            {
+                std::uint16_t audioFormat = ReadU16(&body[0]);
+                channels = ReadU16(&body[2]);
+                sampleRate = static_cast<int>(ReadU32(&body[4]));
+                const std::uint16_t bitsPerSample = ReadU16(&body[14]);
+
+                // WAVE_FORMAT_EXTENSIBLE stores the actual format in the sub-format GUID
+                if (audioFormat == 0xFFFE && 26 <= chunkSize)
+                {
+                    audioFormat = ReadU16(&body[24]);
+                }
+
+                if (audioFormat == 1 && bitsPerSample == 16)
+                {
+                    sampleFormat = StreamFormat::S16LE;
+                }
+                else if (audioFormat == 3 && bitsPerSample == 32)
+                {
+                    sampleFormat = StreamFormat::F32LE;
+                }
+                else
+                {
+                    std::cerr << "error: unsupported WAVE format " << audioFormat << " (" << bitsPerSample << " bits)" << std::endl;
+                    std::cerr << "       only 16-bit PCM and 32-bit float are supported.\n";
+                    return false;
+                }
+
+                hasFormat = true;
+            }
+        }
+    }
+
+    static constexpr std::uint64_t UnknownSize = UINT64_MAX;
+
+    StreamFormat format = StreamFormat::S16LE;
+    StreamFormat sampleFormat = StreamFormat::S16LE;
+    int channels = 2;
+    int sampleRate = 48000;
+
+    std::FILE* file = nullptr;
+    std::vector<std::uint8_t> readBuffer;
+    size_t hopSize = 0;
+    bool open = false;
+    // the PCM bytes left in the data chunk of a WAVE stream
+    std::uint64_t dataRemaining = UnknownSize;
+
+    std::vector<std::vector<float>> buffers;
+    size_t currentHeadIndex = 0;
+    size_t readCount = 0;
+    std::chrono::steady_clock::time_point latestTime = std::chrono::steady_clock::now();
+};
@@ -3,6 +3,10 @@
 #ifdef ANALYZER_USE_WASAPI
 
 #include <string>
+#include <chrono>
+#include <thread>
+#include <functional>
+#include <algorithm>
 
 #define NOMINMAX
 #include <Windows.h>
@@ -11,13 +15,29 @@
 #include <Audioclient.h>
 #include <avrt.h>
 
+#include "SpectrumKernels.hpp"
+
 class SoundCapturerWASAPI
 {
 public:
 
     SoundCapturerWASAPI() = default;
 
-    bool init(size_t bufferSize, int samplingFrequency)
+    explicit SoundCapturerWASAPI(int channels)
+    {
+        wfx.nChannels = static_cast<WORD>(channels);
+        wfx.nBlockAlign = wfx.nChannels * wfx.wBitsPerSample / 8;
+    }
+
+    // The loopback stream already runs at the period of the shared-mode engine and update() polls
+    // every millisecond, so there is nothing left to tune.
+    void setLowLatency(bool)
+    {
+    }
+
+    // bufferSize gives the samples per channel to keep at the sampling frequency of the stream.
+    // samplingFrequency 0 takes the rate of the shared-mode mix format, which the engine does not resample.
+    bool init(const std::function<size_t(int)>& bufferSize, int samplingFrequency)
     {
         HRESULT hr = CoInitialize(nullptr);
         if (FAILED(hr))
@@ -50,6 +70,20 @@ public:
             return false;
         }
 
+        if (samplingFrequency == 0)
+        {
+            WAVEFORMATEX* mixFormat = nullptr;
+            hr = pAudioClient->GetMixFormat(&mixFormat);
+            if (FAILED(hr))
+            {
+                std::cerr << "GetMixFormat() failed" << std::endl;
+                return false;
+            }
+
+            samplingFrequency = static_cast<int>(mixFormat->nSamplesPerSec);
+            CoTaskMemFree(mixFormat);
+        }
+
         wfx.nSamplesPerSec = samplingFrequency;
         wfx.nAvgBytesPerSec = wfx.nSamplesPerSec * wfx.nBlockAlign;
 
@@ -82,7 +116,7 @@ public:
             return false;
         }
 
-        buffer.resize(bufferSize);
+        buffers.assign(wfx.nChannels, std::vector<float>(bufferSize(samplingFrequency)));
 
         return true;
     }
@@ -101,25 +135,46 @@ public:
             short* readData;
             UINT32 numFramesToRead;
             DWORD flags;
-            hr = pAudioCaptureClient->GetBuffer(reinterpret_cast<BYTE**>(&readData), &numFramesToRead, &flags, nullptr, nullptr);
+            UINT64 qpcPosition = 0;
+            hr = pAudioCaptureClient->GetBuffer(reinterpret_cast<BYTE**>(&readData), &numFramesToRead, &flags, nullptr, &qpcPosition);
             if (FAILED(hr))
             {
                 std::cerr << "GetBuffer() failed" << std::endl;
                 return;
             }
 
-            if (wfx.nChannels == 2 && wfx.wBitsPerSample == 16)
+            if (wfx.wBitsPerSample == 16)
             {
-                const LONG bytesLength = numFramesToRead * wfx.nBlockAlign;
-                const auto count = bytesLength / sizeof(short);
+                const size_t channels = wfx.nChannels;
+
+                const size_t bufferCount = buffers[0].size();
 
-                for (size_t i = 0; i < count; i += 2)
+                // converted in contiguous spans up to the end of the ring buffer
+                for (size_t frame = 0; frame < numFramesToRead;)
                 {
-                    buffer[currentHeadIndex] = readData[i] / 32767.0f;
-                    ++currentHeadIndex;
-                    currentHeadIndex %= buffer.size();
+                    const size_t count = std::min<size_t>(numFramesToRead - frame, bufferCount - currentHeadIndex);
+                    for (size_t channel = 0; channel < channels; ++channel)
+                    {
+                        SpectrumKernels::S16ToFloat(readData + frame * channels + channel, channels, buffers[channel].data() + currentHeadIndex, count);
+                    }
+
+                    frame += count;
+                    currentHeadIndex += count;
+                    if (currentHeadIndex == bufferCount)
+                    {
+                        currentHeadIndex = 0;
+                    }
                 }
-                readCount += count / 2;
+                readCount += numFramesToRead;
+
+                // qpcPosition is the capture time of the first frame of the packet, in 100 ns units of the performance counter
+                LARGE_INTEGER counter;
+                LARGE_INTEGER frequency;
+                QueryPerformanceCounter(&counter);
+                QueryPerformanceFrequency(&frequency);
+                const double age = counter.QuadPart * (1.0e7 / frequency.QuadPart) - static_cast<double>(qpcPosition);
+                const double packetDuration = 1.0e7 * numFramesToRead / wfx.nSamplesPerSec;
+                latestTime = std::chrono::steady_clock::now() - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::ratio<1, 10000000>>(age - packetDuration));
             }
             else
             {
@@ -136,9 +191,34 @@ public:
         }
     }
 
-    const std::vector<float>& getBuffer()const
+    // polls the capture client until minReadCount samples have been read or the deadline passes
+    void waitForSamples(size_t minReadCount, std::chrono::steady_clock::time_point deadline)
     {
-        return buffer;
+        for (update(); readCount < minReadCount && std::chrono::steady_clock::now() < deadline; update())
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    bool isOpen()const
+    {
+        return pAudioCaptureClient != nullptr;
+    }
+
+    // the rate of the stream, decided by init()
+    int samplingFrequency()const
+    {
+        return static_cast<int>(wfx.nSamplesPerSec);
+    }
+
+    size_t channelCount()const
+    {
+        return buffers.size();
+    }
+
+    const std::vector<float>& getBuffer(size_t channel = 0)const
+    {
+        return buffers[channel];
     }
 
     size_t bufferHeadIndex()const
@@ -151,11 +231,24 @@ public:
         return readCount;
     }
 
+    // when the newest sample was captured, from the time stamps of the packets
+    std::chrono::steady_clock::time_point latestSampleTime()const
+    {
+        return latestTime;
+    }
+
+    // the packet time stamps already include the device
+    std::chrono::microseconds deviceLatency()const
+    {
+        return std::chrono::microseconds(0);
+    }
+
 private:
 
-    std::vector<float> buffer;
+    std::vector<std::vector<float>> buffers;
     size_t currentHeadIndex = 0;
     size_t readCount = 0;
+    std::chrono::steady_clock::time_point latestTime = std::chrono::steady_clock::now();
 
     WAVEFORMATEX wfx = {
         .wFormatTag = WAVE_FORMAT_PCM,
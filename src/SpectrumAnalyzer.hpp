@@ -1,33 +1,53 @@
+#pragma once
+
 #include <vector>
 #include <cstdint>
 #include <cmath>
 #include <cassert>
 #include <sstream>
 #include <limits>
+#include <algorithm>
+#include <type_traits>
 
 #include <fft.h>
 #include <fft_internal.h>
 
+#include "BandPlan.hpp"
+#include "WindowFunction.hpp"
+#include "SpectrumKernels.hpp"
+#include "FrameStats.hpp"
+#include "FftPlanCache.hpp"
+
+enum class StftAggregate
+{
+    Latest,
+    Max,
+    Mean,
+};
+
 class SpectrumAnalyzer
 {
 public:
 
     SpectrumAnalyzer() = default;
 
-    SpectrumAnalyzer(size_t inputSampleSize, size_t fftSampleSize, int samplingFrequency)
+    SpectrumAnalyzer(size_t inputSampleSize, size_t fftSampleSize, int samplingFrequency, WindowType windowType = WindowType::Hamming, const FftPlanSettings& settings = FftPlanSettings())
     {
-        init(inputSampleSize, fftSampleSize, samplingFrequency);
+        init(inputSampleSize, fftSampleSize, samplingFrequency, windowType, settings);
     }
 
     ~SpectrumAnalyzer()
     {
-        mufft_free(input);
         mufft_free(input2);
         mufft_free(output);
+        mufft_free(window);
+        mufft_free(batchInput);
+        mufft_free(batchOutput);
         mufft_free_plan_1d(muplan);
     }
 
-    void init(size_t inputSampleSize, size_t fftSampleSize, int samplingFrequency)
+    // settings gives the muFFT plan flags, and the level calibration if it is already known
+    void init(size_t inputSampleSize, size_t fftSampleSize, int samplingFrequency, WindowType windowType = WindowType::Hamming, const FftPlanSettings& settings = FftPlanSettings())
     {
         inputSampleSize = std::min(inputSampleSize, fftSampleSize);
 
@@ -39,12 +59,32 @@ public:
         //std::cout << "inputSize: " << inputSize << std::endl;
         //std::cout << "fftSize: " << fftSize << std::endl;
 
-        input = static_cast<float*>(mufft_alloc(inputSampleSize * sizeof(float)));
         input2 = static_cast<float*>(mufft_alloc(fftSize * sizeof(float)));
         output = static_cast<cfloat*>(mufft_alloc(fftSize * sizeof(cfloat)));
-        muplan = mufft_create_plan_1d_r2c(fftSize, MUFFT_FLAG_CPU_ANY);
+        window = static_cast<float*>(mufft_alloc(inputSampleSize * sizeof(float)));
+        planFlags = settings.flags;
+        muplan = mufft_create_plan_1d_r2c(fftSize, planFlags);
+        if (!muplan && planFlags != MUFFT_FLAG_CPU_ANY)
+        {
+            // a variant this CPU or muFFT build cannot plan
+            planFlags = MUFFT_FLAG_CPU_ANY;
+            muplan = mufft_create_plan_1d_r2c(fftSize, planFlags);
+        }
+
+        WindowFunction::Fill(windowType, window, inputSize);
 
-        initZeroLevel();
+        powers.resize(binCount());
+
+        // input2[inputSize, fftSize) is never written afterwards
+        if (settings.calibrated)
+        {
+            std::fill(input2 + inputSize, input2 + fftSize, 0.0f);
+            zeroLevel = settings.zeroLevel;
+        }
+        else
+        {
+            initZeroLevel();
+        }
     }
 
     void update(const std::vector<float>& buffer, size_t headIndex, float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
@@ -54,26 +94,179 @@ public:
             assert(buffer.size() < inputSize);
         }
 
-        for (size_t i = 0; i < inputSize; ++i)
+        // the latest inputSize samples, in case the buffer keeps a longer history,
+        // are windowed straight into the FFT input
+        const size_t startIndex = (headIndex + buffer.size() - inputSize) % buffer.size();
         {
-            input[i] = buffer[(headIndex + i) % buffer.size()];
+            ANALYZER_STATS_SCOPE(stats, Stage::Window);
+            copyWindowed(buffer, startIndex, input2);
         }
 
-        executeFFT();
+        {
+            ANALYZER_STATS_SCOPE(stats, Stage::Fft);
+            mufft_execute_plan_1d(muplan, output, input2);
+        }
 
+        ANALYZER_STATS_SCOPE(stats, Stage::Bands);
         updateSpectrum(minLevel, maxLevel, freqMin, freqMax, logBase);
     }
 
-    const std::vector<float>& spectrum()const
+    // Short-time analysis with a fixed hop: analyzes every frame of inputSize samples whose end
+    // (counted in samples read by the capturer, on multiples of hopSize) arrived since the previous
+    // call. The FFTs of up to stftBatchSize frames are executed back to back on contiguous buffers.
+    // Frames that already left the buffer are skipped and counted in stftDroppedFrames().
+    //
+    // onFrame, if given, is called with the spectrum of each frame in order. It is a template parameter
+    // rather than a std::function, which would be constructed every frame. Afterwards spectrum()
+    // holds the frames combined by aggregate. Returns the number of frames analyzed.
+    template<class OnFrame = std::nullptr_t>
+    size_t updateStft(const std::vector<float>& buffer, size_t headIndex, size_t readCount, size_t hopSize, StftAggregate aggregate,
+        float minLevel, float maxLevel, float freqMin, float freqMax, float logBase, const OnFrame& onFrame = nullptr)
+    {
+        constexpr bool eachFrame = !std::is_same_v<OnFrame, std::nullptr_t>;
+
+        assert(0 < hopSize);
+
+        prepareBandPlans(minLevel, maxLevel, freqMin, freqMax, logBase);
+
+        if (!batchInput)
+        {
+            batchOutputStride = (binCount() + 7) & ~size_t(7);
+            batchInput = static_cast<float*>(mufft_alloc(stftBatchSize * fftSize * sizeof(float)));
+            batchOutput = static_cast<cfloat*>(mufft_alloc(stftBatchSize * batchOutputStride * sizeof(cfloat)));
+            std::fill(batchInput, batchInput + stftBatchSize * fftSize, 0.0f);
+            batchPowers.resize(stftBatchSize * binCount());
+        }
+
+        const size_t bufferCount = buffer.size();
+        const size_t binLimit = powerBinLimit();
+
+        // the oldest frame end that is still entirely in the buffer
+        const size_t oldestEnd = std::max(inputSize, readCount + inputSize - std::min(readCount + inputSize, bufferCount));
+        size_t frameEnd = std::max(stftFrameEnd + hopSize, (oldestEnd + hopSize - 1) / hopSize * hopSize);
+        if (stftFrameEnd != 0 && stftFrameEnd + hopSize < frameEnd)
+        {
+            droppedFrames += (frameEnd - stftFrameEnd) / hopSize - 1;
+        }
+
+        size_t frameCount = 0;
+        while (frameEnd <= readCount)
+        {
+            size_t batchCount = 0;
+            {
+                ANALYZER_STATS_SCOPE(stats, Stage::Window);
+                for (; batchCount < stftBatchSize && frameEnd <= readCount; ++batchCount, frameEnd += hopSize)
+                {
+                    const size_t offset = readCount - (frameEnd - inputSize);
+                    const size_t startIndex = (headIndex + bufferCount - offset) % bufferCount;
+                    copyWindowed(buffer, startIndex, batchInput + batchCount * fftSize);
+                }
+            }
+
+            for (size_t i = 0; i < batchCount; ++i)
+            {
+                ANALYZER_STATS_SCOPE(stats, Stage::Fft);
+                mufft_execute_plan_1d(muplan, batchOutput + i * batchOutputStride, batchInput + i * fftSize);
+            }
+
+            for (size_t i = 0; i < batchCount; ++i)
+            {
+                float* framePowers = batchPowers.data() + i * binCount();
+                {
+                    ANALYZER_STATS_SCOPE(stats, Stage::Bands);
+                    SpectrumKernels::MagnitudeSquared(batchOutput + i * batchOutputStride, framePowers, binLimit);
+
+                    if constexpr (eachFrame)
+                    {
+                        bandPlan.apply(framePowers, normalizeDb(), frameView);
+                    }
+                }
+
+                if constexpr (eachFrame)
+                {
+                    onFrame(frameView);
+                }
+
+                if (frameCount == 0 || aggregate == StftAggregate::Latest)
+                {
+                    std::copy(framePowers, framePowers + binLimit, powers.begin());
+                }
+                else if (aggregate == StftAggregate::Max)
+                {
+                    for (size_t j = 0; j < binLimit; ++j)
+                    {
+                        powers[j] = std::max(powers[j], framePowers[j]);
+                    }
+                }
+                else
+                {
+                    for (size_t j = 0; j < binLimit; ++j)
+                    {
+                        powers[j] += framePowers[j];
+                    }
+                }
+
+                ++frameCount;
+            }
+        }
+
+        if (frameCount == 0)
+        {
+            return 0;
+        }
+
+        stftFrameEnd = frameEnd - hopSize;
+
+        if (aggregate == StftAggregate::Mean)
+        {
+            const float scale = 1.0f / frameCount;
+            for (size_t j = 0; j < binLimit; ++j)
+            {
+                powers[j] *= scale;
+            }
+        }
+
+        ANALYZER_STATS_SCOPE(stats, Stage::Bands);
+        bandPlan.apply(powers.data(), normalizeDb(), spectrumView);
+        applyViews();
+
+        return frameCount;
+    }
+
+    size_t stftDroppedFrames()const
     {
-        return spectrumView;
+        return droppedFrames;
     }
 
-    std::vector<std::pair<std::string, float>> getLabels(float freqMin, float freqMax, float logBase)const
+    // Records the time of the stages of update() and updateStft() in stats (see --stats), nullptr to stop.
+    void setStats(FrameStats* frameStats)
     {
-        std::vector<std::pair<std::string, float>> labels;
+        stats = frameStats;
+    }
+
+    // Adds another mapping of the same FFT result onto display bands, e.g. for an output profile
+    // with its own frequency and level range. Views must be added before the first update.
+    // Returns the index to pass to spectrum(); index 0 is the view given to update().
+    size_t addView(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        views.push_back(View{minLevel, maxLevel, freqMin, freqMax, logBase});
+        return views.size();
+    }
+
+    const std::vector<float>& spectrum(size_t view = 0)const
+    {
+        return view == 0 ? spectrumView : views[view - 1].spectrum;
+    }
+
+    size_t viewCount()const
+    {
+        return views.size() + 1;
+    }
 
-        const size_t outputSize = fftSize;
+    // the axis labels and their positions in [0, 1], which only depend on the display range
+    static std::vector<std::pair<std::string, float>> GetLabels(float freqMin, float freqMax, float logBase)
+    {
+        std::vector<std::pair<std::string, float>> labels;
 
         const float logFreqMin = std::pow(freqMin, 1.0f / logBase);
         const float logFreqMax = std::pow(freqMax, 1.0f / logBase);
@@ -116,16 +309,26 @@ public:
         for (size_t i = 0; i < freqLabels.size(); ++i)
         {
             const int freq = freqLabels[i];
-            const float index = getAbscissa(freq, logBase, logFreqMin, logFreqMax);
+            const float index = GetAbscissa(freq, logBase, logFreqMin, logFreqMax);
             labels.emplace_back(getLabelStr(freq), index);
         }
 
         return labels;
     }
 
-private:
+    // the plan flags and the calibration in use, to be stored in a FftPlanCache
+    FftPlanSettings fftPlanSettings()const
+    {
+        FftPlanSettings settings;
+        settings.flags = planFlags;
+        settings.calibrated = true;
+        settings.zeroLevel = zeroLevel;
+        return settings;
+    }
 
-    void initZeroLevel()
+    // The level of a full-scale 1 kHz sine over inputSize samples, which the display range is relative to.
+    // Runs plan on input (fftSize values, zero-filled from inputSize on) and output.
+    static float ZeroLevel(mufft_plan_1d* plan, float* input, cfloat* output, size_t inputSize, size_t fftSize, float sampleFreq)
     {
         const int freq = 1000;
         const float pi = 3.1415926535f;
@@ -133,120 +336,158 @@ private:
         {
             const float t = 1.0f * i / sampleFreq;
             const float x = std::sin(freq * 2.0f * pi * t);
-            input2[i] = x;
+            input[i] = x;
         }
 
-        for (int i = inputSize; i < fftSize; ++i)
+        for (size_t i = inputSize; i < fftSize; ++i)
         {
-            input2[i] = 0;
+            input[i] = 0;
         }
 
-        mufft_execute_plan_1d(muplan, output, input2);
+        mufft_execute_plan_1d(plan, output, input);
 
-        zeroLevel = std::numeric_limits<float>::lowest();
-        for (size_t i = 1; i < fftSize; ++i)
+        const float unitFreq = sampleFreq / static_cast<float>(fftSize);
+        const float normalizeCoef = 2.0f / fftSize;
+
+        float zeroLevel = std::numeric_limits<float>::lowest();
+        for (size_t i = 1; i < fftSize / 2 + 1; ++i)
         {
-            const float pressureMax = getPower(i);
+            const float rx = output[i].real;
+            const float ix = output[i].imag;
+            const float pressureMax = normalizeCoef * std::sqrt(rx * rx + ix * ix);
 
             const float f = unitFreq * i;
 
             //d weighting
-            const float hf = ((1037918.48f - f * f) * (1037918.48f - f * f) + 1080768.16f * f * f) /
-                ((9837328.0f - f * f) * (9837328.0f - f * f) + 11723776.0f * f * f);
-            const float rd = (f / (6.8966888496476f * 1.0e-5f)) * std::sqrt(hf / ((f * f + 79919.29f) * (f * f + 1345600.0f)));
-            const float spl = 10.0f * std::log10(rd * pressureMax);
-
-            //const float spl = 10.0f * std::log10(pressureMax);
+            const float spl = 10.0f * std::log10(BandPlan::DWeighting(f) * pressureMax);
 
             zeroLevel = std::max(spl, zeroLevel);
         }
-    }
-
-    void executeFFT()
-    {
-        const float pi = 3.1415926535f;
-        for (int i = 0; i < inputSize; ++i)
-        {
-            const float t = 1.0f * i / (inputSize - 1);
-            const float hammingWindow = (0.54f - 0.46f * std::cos(2.0f * pi * t));
-            input2[i] = hammingWindow * input[i];
-        }
-
-        for (int i = inputSize; i < fftSize; ++i)
-        {
-            input2[i] = 0;
-        }
 
-        mufft_execute_plan_1d(muplan, output, input2);
+        return zeroLevel;
     }
 
-    float getLogScaledFreq(float t, float logBase, float logFreqMin, float logFreqMax)const
+private:
+
+    void initZeroLevel()
     {
-        const float logFreq = logFreqMin + (logFreqMax - logFreqMin) * t;
-        const float freq = std::pow(logFreq, logBase);
-        return freq;
+        zeroLevel = ZeroLevel(muplan, input2, output, inputSize, fftSize, sampleFreq);
     }
 
-    float getAbscissa(float freq, float logBase, float logFreqMin, float logFreqMax)const
+    static float GetAbscissa(float freq, float logBase, float logFreqMin, float logFreqMax)
     {
         const float logFreq = std::pow(freq, 1.0f / logBase);
         return (logFreq - logFreqMin) / (logFreqMax - logFreqMin);
     }
 
-    float getPower(size_t index)
+    size_t binCount()const
     {
-        const float normalizeCoef = 2.0f / fftSize;
-        const cfloat a = output[index];
-        float rx = a.real;
-        float ix = a.imag;
-        return normalizeCoef * std::sqrt(rx * rx + ix * ix);
+        return fftSize / 2 + 1;
     }
 
-    void updateSpectrum(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    // the FFT normalization 2/fftSize, in dB of magnitude
+    float normalizeDb()const
     {
-        const size_t outputSize = fftSize;
-        const float normalizeCoef = 2.0f / outputSize;
-
-        const float logFreqMin = std::pow(freqMin, 1.0f / logBase);
-        const float logFreqMax = std::pow(freqMax, 1.0f / logBase);
+        return 10.0f * std::log10(2.0f / fftSize);
+    }
 
+    void prepareBandPlan(BandPlan& plan, float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)const
+    {
+        const size_t bandCount = fftSize - 1;
         const float bottomLevel = zeroLevel + minLevel;
         const float topLevel = zeroLevel + maxLevel;
 
-        spectrumView.resize(outputSize - 1);
-        for (size_t i = 0; i < spectrumView.size(); ++i)
+        if (!plan.matches(bandCount, unitFreq, freqMin, freqMax, logBase, bottomLevel, topLevel))
+        {
+            plan.build(bandCount, binCount(), unitFreq, freqMin, freqMax, logBase, bottomLevel, topLevel);
+        }
+    }
+
+    void prepareBandPlans(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        prepareBandPlan(bandPlan, minLevel, maxLevel, freqMin, freqMax, logBase);
+
+        for (auto& view : views)
         {
-            const float t0 = 1.0 * i / spectrumView.size();
-            const float t1 = 1.0 * (i + 1) / spectrumView.size();
+            prepareBandPlan(view.plan, view.minLevel, view.maxLevel, view.freqMin, view.freqMax, view.logBase);
+        }
+    }
 
-            const int index0 = static_cast<int>(std::floor(getLogScaledFreq(t0, logBase, logFreqMin, logFreqMax) / unitFreq));
-            const int index1 = static_cast<int>(std::floor(getLogScaledFreq(t1, logBase, logFreqMin, logFreqMax) / unitFreq));
+    // the bins any of the views reads
+    size_t powerBinLimit()const
+    {
+        size_t binLimit = bandPlan.binLimit();
+        for (const auto& view : views)
+        {
+            binLimit = std::max(binLimit, view.plan.binLimit());
+        }
+        return binLimit;
+    }
 
-            float pressureMax = getPower(index0);
-            for (int j = index0 + 1; j < index1; ++j)
-            {
-                //pressureMax = std::max(pressureMax, getPower(j));
-                pressureMax += getPower(j);
-            }
+    void applyViews()
+    {
+        for (auto& view : views)
+        {
+            view.plan.apply(powers.data(), normalizeDb(), view.spectrum);
+        }
+    }
 
-            const float f = unitFreq * (index0 + index1) * 0.5;
+    void updateSpectrum(float minLevel, float maxLevel, float freqMin, float freqMax, float logBase)
+    {
+        prepareBandPlans(minLevel, maxLevel, freqMin, freqMax, logBase);
 
-            //d weighting
-            const float hf = ((1037918.48f - f * f) * (1037918.48f - f * f) + 1080768.16f * f * f) /
-                ((9837328.0f - f * f) * (9837328.0f - f * f) + 11723776.0f * f * f);
-            const float rd = (f / (6.8966888496476f * 1.0e-5f)) * std::sqrt(hf / ((f * f + 79919.29f) * (f * f + 1345600.0f)));
-            const float spl = 10.0f * std::log10(rd * pressureMax);
+        SpectrumKernels::MagnitudeSquared(output, powers.data(), powerBinLimit());
 
-            const float loudness = std::max(0.0f, (spl - bottomLevel)) / (topLevel - bottomLevel);
+        bandPlan.apply(powers.data(), normalizeDb(), spectrumView);
+        applyViews();
+    }
 
-            spectrumView[i] = loudness;
+    // windows inputSize samples of the ring buffer starting at startIndex into dst
+    void copyWindowed(const std::vector<float>& buffer, size_t startIndex, float* dst)const
+    {
+        const size_t firstCount = std::min(inputSize, buffer.size() - startIndex);
+        const float* first = buffer.data() + startIndex;
+        for (size_t i = 0; i < firstCount; ++i)
+        {
+            dst[i] = window[i] * first[i];
+        }
+
+        const float* second = buffer.data();
+        for (size_t i = firstCount; i < inputSize; ++i)
+        {
+            dst[i] = window[i] * second[i - firstCount];
         }
     }
 
+    struct View
+    {
+        float minLevel = 0.0f;
+        float maxLevel = 0.0f;
+        float freqMin = 0.0f;
+        float freqMax = 0.0f;
+        float logBase = 0.0f;
+        BandPlan plan;
+        std::vector<float> spectrum;
+    };
+
     std::vector<float> spectrumView;
+    std::vector<float> powers;
+    BandPlan bandPlan;
+    std::vector<View> views;
+
+    static constexpr size_t stftBatchSize = 8;
+    float* batchInput = nullptr;
+    cfloat* batchOutput = nullptr;
+    size_t batchOutputStride = 0;
+    std::vector<float> batchPowers;
+    std::vector<float> frameView;
+    size_t stftFrameEnd = 0;
+    size_t droppedFrames = 0;
+
+    FrameStats* stats = nullptr;
 
-    float* input = nullptr;
     float* input2 = nullptr;
+    float* window = nullptr;
     cfloat* output = nullptr;
     mufft_plan_1d* muplan = nullptr;
 
@@ -255,4 +496,5 @@ private:
     float unitFreq = 0.0f;
     float sampleFreq = 0.0f;
     float zeroLevel = 0.0f;
+    unsigned planFlags = MUFFT_FLAG_CPU_ANY;
 };
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+
+#include <fft_internal.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define ANALYZER_KERNELS_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define ANALYZER_TARGET_AVX2
+#else
+#define ANALYZER_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(ANALYZER_KERNELS_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && 2 <= _M_IX86_FP))
+#define ANALYZER_KERNELS_SSE2
+#endif
+
+// Vectorized kernels for the spectrum stage, dispatched at runtime to AVX2, SSE2 or scalar code.
+//
+// Log10 is evaluated as exponent + atanh series on the mantissa.
+// Its absolute error is below 4e-6 for normal positive inputs (below 4e-5 dB on a 10*log10 scale).
+// Zero, negative and denormal inputs return -infinity.
+class SpectrumKernels
+{
+public:
+
+    enum class Level
+    {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    // out[i] = |in[i]|^2
+    static void MagnitudeSquared(const cfloat* in, float* out, size_t count)
+    {
+        Get().magnitudeSquared(in, out, count);
+    }
+
+    // sum of sqrt(in[i])
+    static float SumSqrt(const float* in, size_t count)
+    {
+        return Get().sumSqrt(in, count);
+    }
+
+    // out[i] = log10(in[i]), in and out may alias
+    static void Log10(const float* in, float* out, size_t count)
+    {
+        Get().log10(in, out, count);
+    }
+
+    // out[i] = in[i * stride] / 32767, converts one channel of interleaved 16-bit PCM
+    static void S16ToFloat(const std::int16_t* in, size_t stride, float* out, size_t count)
+    {
+        Get().s16ToFloat(in, stride, out, count);
+    }
+
+    static Level GetLevel()
+    {
+        return Get().level;
+    }
+
+    static const char* GetLevelName()
+    {
+        switch (GetLevel())
+        {
+        case Level::AVX2: return "avx2";
+        case Level::SSE2: return "sse2";
+        default: return "scalar";
+        }
+    }
+
+    // Forces a dispatch level, e.g. to compare against the scalar path.
+    static void SetLevel(Level level)
+    {
+        Get() = Make(level);
+    }
+
+    static float Log10Scalar(float x)
+    {
+        if (!(std::numeric_limits<float>::min() <= x))
+        {
+            return -std::numeric_limits<float>::infinity();
+        }
+
+        std::uint32_t bits;
+        std::memcpy(&bits, &x, sizeof(bits));
+
+        int exponent = static_cast<int>(bits >> 23) - 127;
+        bits = (bits & 0x007fffffu) | 0x3f800000u;
+
+        float m;
+        std::memcpy(&m, &bits, sizeof(m));
+        if (1.41421356f < m)
+        {
+            m *= 0.5f;
+            ++exponent;
+        }
+
+        const float t = (m - 1.0f) / (m + 1.0f);
+        const float t2 = t * t;
+        const float ln = 2.0f * t * (1.0f + t2 * (1.0f / 3.0f + t2 * (1.0f / 5.0f + t2 * (1.0f / 7.0f))));
+
+        return exponent * log10Of2Hi + (exponent * log10Of2Lo + ln * log10OfE);
+    }
+
+private:
+
+    // log10(2) split so that exponent * log10Of2Hi is exact (11 significant bits), and the result of
+    // log10 is only rounded once at large exponents
+    static constexpr float log10Of2Hi = 0.301025390625f;
+    static constexpr float log10Of2Lo = 4.6050389811980e-6f;
+    static constexpr float log10OfE = 0.43429448190f;
+    // a division, not a multiplication by 1 / 32767, which rounds differently for some samples
+    static constexpr float s16FullScale = 32767.0f;
+
+    struct Kernels
+    {
+        Level level = Level::Scalar;
+        void (*magnitudeSquared)(const cfloat*, float*, size_t) = nullptr;
+        float (*sumSqrt)(const float*, size_t) = nullptr;
+        void (*log10)(const float*, float*, size_t) = nullptr;
+        void (*s16ToFloat)(const std::int16_t*, size_t, float*, size_t) = nullptr;
+    };
+
+    static Kernels& Get()
+    {
+        static Kernels kernels = Make(Detect());
+        return kernels;
+    }
+
+    static Level Detect()
+    {
+#if defined(ANALYZER_KERNELS_X86)
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (7 <= info[0])
+        {
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            __cpuidex(info, 7, 0);
+            const bool avx2 = (info[1] & (1 << 5)) != 0;
+            if (osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6)
+            {
+                return Level::AVX2;
+            }
+        }
+#else
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return Level::AVX2;
+        }
+#endif
+#endif
+
+#if defined(ANALYZER_KERNELS_SSE2)
+        return Level::SSE2;
+#else
+        return Level::Scalar;
+#endif
+    }
+
+    static Kernels Make(Level level)
+    {
+        Kernels kernels;
+        kernels.level = Level::Scalar;
+        kernels.magnitudeSquared = MagnitudeSquaredScalar;
+        kernels.sumSqrt = SumSqrtScalar;
+        kernels.log10 = Log10ArrayScalar;
+        kernels.s16ToFloat = S16ToFloatScalar;
+
+#if defined(ANALYZER_KERNELS_SSE2)
+        if (level == Level::SSE2 || level == Level::AVX2)
+        {
+            kernels.level = Level::SSE2;
+            kernels.magnitudeSquared = MagnitudeSquaredSSE2;
+            kernels.sumSqrt = SumSqrtSSE2;
+            kernels.log10 = Log10ArraySSE2;
+            kernels.s16ToFloat = S16ToFloatSSE2;
+        }
+#endif
+
+#if defined(ANALYZER_KERNELS_X86)
+        if (level == Level::AVX2)
+        {
+            kernels.level = Level::AVX2;
+            kernels.magnitudeSquared = MagnitudeSquaredAVX2;
+            kernels.sumSqrt = SumSqrtAVX2;
+            kernels.log10 = Log10ArrayAVX2;
+            kernels.s16ToFloat = S16ToFloatAVX2;
+        }
+#endif
+
+        return kernels;
+    }
+
+    static void MagnitudeSquaredScalar(const cfloat* in, float* out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = in[i].real * in[i].real + in[i].imag * in[i].imag;
+        }
+    }
+
+    static float SumSqrtScalar(const float* in, size_t count)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            sum += std::sqrt(in[i]);
+        }
+        return sum;
+    }
+
+    static void Log10ArrayScalar(const float* in, float* out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = Log10Scalar(in[i]);
+        }
+    }
+
+    static void S16ToFloatScalar(const std::int16_t* in, size_t stride, float* out, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            out[i] = in[i * stride] / s16FullScale;
+        }
+    }
+
+#if defined(ANALYZER_KERNELS_SSE2)
+    static void MagnitudeSquaredSSE2(const cfloat* in, float* out, size_t count)
+    {
+        const float* src = reinterpret_cast<const float*>(in);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 a = _mm_loadu_ps(src + i * 2);
+            const __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+            const __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im)));
+        }
+
+        MagnitudeSquaredScalar(in + i, out + i, count - i);
+    }
+
+    static float SumSqrtSSE2(const float* in, size_t count)
+    {
+        __m128 acc = _mm_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            acc = _mm_add_ps(acc, _mm_sqrt_ps(_mm_loadu_ps(in + i)));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, acc);
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + SumSqrtScalar(in + i, count - i);
+    }
+
+    static void Log10ArraySSE2(const float* in, float* out, size_t count)
+    {
+        const __m128 minNormal = _mm_set1_ps(std::numeric_limits<float>::min());
+        const __m128 negInf = _mm_set1_ps(-std::numeric_limits<float>::infinity());
+        const __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+        const __m128i one = _mm_set1_epi32(0x3f800000);
+        const __m128i bias = _mm_set1_epi32(127);
+        const __m128 sqrt2 = _mm_set1_ps(1.41421356f);
+        const __m128 c1 = _mm_set1_ps(1.0f);
+        const __m128 c3 = _mm_set1_ps(1.0f / 3.0f);
+        const __m128 c5 = _mm_set1_ps(1.0f / 5.0f);
+        const __m128 c7 = _mm_set1_ps(1.0f / 7.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 two = _mm_set1_ps(2.0f);
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            const __m128 x = _mm_loadu_ps(in + i);
+            const __m128i bits = _mm_castps_si128(x);
+
+            __m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), bias));
+            __m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), one));
+
+            const __m128 large = _mm_cmpgt_ps(m, sqrt2);
+            m = _mm_or_ps(_mm_and_ps(large, _mm_mul_ps(m, half)), _mm_andnot_ps(large, m));
+            e = _mm_add_ps(e, _mm_and_ps(large, c1));
+
+            const __m128 t = _mm_div_ps(_mm_sub_ps(m, c1), _mm_add_ps(m, c1));
+            const __m128 t2 = _mm_mul_ps(t, t);
+            __m128 p = _mm_add_ps(c5, _mm_mul_ps(t2, c7));
+            p = _mm_add_ps(c3, _mm_mul_ps(t2, p));
+            p = _mm_add_ps(c1, _mm_mul_ps(t2, p));
+            const __m128 ln = _mm_mul_ps(_mm_mul_ps(two, t), p);
+
+            const __m128 y = _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(log10Of2Hi)), _mm_add_ps(_mm_mul_ps(e, _mm_set1_ps(log10Of2Lo)), _mm_mul_ps(ln, _mm_set1_ps(log10OfE))));
+
+            const __m128 valid = _mm_cmpge_ps(x, minNormal);
+            _mm_storeu_ps(out + i, _mm_or_ps(_mm_and_ps(valid, y), _mm_andnot_ps(valid, negInf)));
+        }
+
+        Log10ArrayScalar(in + i, out + i, count - i);
+    }
+
+    // mono and stereo are vectorized, other layouts are strided scalar loads anyway
+    static void S16ToFloatSSE2(const std::int16_t* in, size_t stride, float* out, size_t count)
+    {
+        const __m128 fullScale = _mm_set1_ps(s16FullScale);
+
+        size_t i = 0;
+        if (stride == 1)
+        {
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                // sign-extend by moving each sample to the upper half of a 32-bit lane
+                const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+                const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+                _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(lo), fullScale));
+                _mm_storeu_ps(out + i + 4, _mm_div_ps(_mm_cvtepi32_ps(hi), fullScale));
+            }
+        }
+        else if (stride == 2)
+        {
+            // the load spans the whole last frame, of which in may point at the second sample,
+            // so the last frame is always left to the scalar loop
+            for (; i + 4 < count; i += 4)
+            {
+                // 4 frames; the wanted channel is the low half of each 32-bit lane
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+                const __m128i samples = _mm_srai_epi32(_mm_slli_epi32(x, 16), 16);
+                _mm_storeu_ps(out + i, _mm_div_ps(_mm_cvtepi32_ps(samples), fullScale));
+            }
+        }
+
+        S16ToFloatScalar(in + i * stride, stride, out + i, count - i);
+    }
+#endif
+
+#if defined(ANALYZER_KERNELS_X86)
+    ANALYZER_TARGET_AVX2 static void MagnitudeSquaredAVX2(const cfloat* in, float* out, size_t count)
+    {
+        const float* src = reinterpret_cast<const float*>(in);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 a = _mm256_loadu_ps(src + i * 2);
+            const __m256 b = _mm256_loadu_ps(src + i * 2 + 8);
+            const __m256 sum = _mm256_hadd_ps(_mm256_mul_ps(a, a), _mm256_mul_ps(b, b));
+            // hadd interleaves the 128-bit lanes of a and b
+            const __m256d ordered = _mm256_permute4x64_pd(_mm256_castps_pd(sum), _MM_SHUFFLE(3, 1, 2, 0));
+            _mm256_storeu_ps(out + i, _mm256_castpd_ps(ordered));
+        }
+
+        MagnitudeSquaredScalar(in + i, out + i, count - i);
+    }
+
+    ANALYZER_TARGET_AVX2 static float SumSqrtAVX2(const float* in, size_t count)
+    {
+        __m256 acc = _mm256_setzero_ps();
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            acc = _mm256_add_ps(acc, _mm256_sqrt_ps(_mm256_loadu_ps(in + i)));
+        }
+
+        alignas(32) float lanes[8];
+        _mm256_store_ps(lanes, acc);
+        return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) + SumSqrtScalar(in + i, count - i);
+    }
+
+    ANALYZER_TARGET_AVX2 static void Log10ArrayAVX2(const float* in, float* out, size_t count)
+    {
+        const __m256 minNormal = _mm256_set1_ps(std::numeric_limits<float>::min());
+        const __m256 negInf = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+        const __m256i mantissaMask = _mm256_set1_epi32(0x007fffff);
+        const __m256i one = _mm256_set1_epi32(0x3f800000);
+        const __m256i bias = _mm256_set1_epi32(127);
+        const __m256 sqrt2 = _mm256_set1_ps(1.41421356f);
+        const __m256 c1 = _mm256_set1_ps(1.0f);
+        const __m256 c3 = _mm256_set1_ps(1.0f / 3.0f);
+        const __m256 c5 = _mm256_set1_ps(1.0f / 5.0f);
+        const __m256 c7 = _mm256_set1_ps(1.0f / 7.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 two = _mm256_set1_ps(2.0f);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            const __m256 x = _mm256_loadu_ps(in + i);
+            const __m256i bits = _mm256_castps_si256(x);
+
+            __m256 e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), bias));
+            __m256 m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), one));
+
+            const __m256 large = _mm256_cmp_ps(m, sqrt2, _CMP_GT_OQ);
+            m = _mm256_blendv_ps(m, _mm256_mul_ps(m, half), large);
+            e = _mm256_add_ps(e, _mm256_and_ps(large, c1));
+
+            const __m256 t = _mm256_div_ps(_mm256_sub_ps(m, c1), _mm256_add_ps(m, c1));
+            const __m256 t2 = _mm256_mul_ps(t, t);
+            __m256 p = _mm256_add_ps(c5, _mm256_mul_ps(t2, c7));
+            p = _mm256_add_ps(c3, _mm256_mul_ps(t2, p));
+            p = _mm256_add_ps(c1, _mm256_mul_ps(t2, p));
+            const __m256 ln = _mm256_mul_ps(_mm256_mul_ps(two, t), p);
+
+            const __m256 y = _mm256_add_ps(_mm256_mul_ps(e, _mm256_set1_ps(log10Of2Hi)), _mm256_add_ps(_mm256_mul_ps(e, _mm256_set1_ps(log10Of2Lo)), _mm256_mul_ps(ln, _mm256_set1_ps(log10OfE))));
+
+            const __m256 valid = _mm256_cmp_ps(x, minNormal, _CMP_GE_OQ);
+            _mm256_storeu_ps(out + i, _mm256_blendv_ps(negInf, y, valid));
+        }
+
+        Log10ArrayScalar(in + i, out + i, count - i);
+    }
+
+    ANALYZER_TARGET_AVX2 static void S16ToFloatAVX2(const std::int16_t* in, size_t stride, float* out, size_t count)
+    {
+        const __m256 fullScale = _mm256_set1_ps(s16FullScale);
+
+        size_t i = 0;
+        if (stride == 1)
+        {
+            for (; i + 8 <= count; i += 8)
+            {
+                const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+                _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(x)), fullScale));
+            }
+        }
+        else if (stride == 2)
+        {
+            // as in S16ToFloatSSE2, the last frame is left to the scalar loop
+            for (; i + 8 < count; i += 8)
+            {
+                const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i * 2));
+                const __m256i samples = _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
+                _mm256_storeu_ps(out + i, _mm256_div_ps(_mm256_cvtepi32_ps(samples), fullScale));
+            }
+        }
+
+        S16ToFloatScalar(in + i * stride, stride, out + i, count - i);
+    }
+#endif
+};
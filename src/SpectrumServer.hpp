@@ -0,0 +1,334 @@
+#pragma once
+
+#ifdef __linux__
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+
+// Pushes every frame to all subscribers connected to a Unix domain socket.
+//
+// Runs on the frame thread without ever blocking it: publish() first handles the pending
+// epoll events (new connections, hang-ups, sockets that became writable), then sends the frame,
+// which is serialized once by the caller, to each client with non-blocking send().
+// A client that cannot take a whole frame keeps the rest of it, and skips the following frames
+// until that rest has been sent, so subscribers only ever see complete frames.
+class SpectrumServer
+{
+public:
+
+    SpectrumServer() = default;
+
+    SpectrumServer(const SpectrumServer&) = delete;
+    SpectrumServer& operator=(const SpectrumServer&) = delete;
+
+    ~SpectrumServer()
+    {
+        for (auto& client : clients)
+        {
+            close(client.socket);
+        }
+
+        if (epollFd >= 0)
+        {
+            close(epollFd);
+        }
+
+        if (listenSocket >= 0)
+        {
+            close(listenSocket);
+            unlink(path.c_str());
+        }
+    }
+
+    bool open(const std::string& socketPath)
+    {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (sizeof(address.sun_path) <= socketPath.size())
+        {
+            std::cerr << "error: socket path \'" << socketPath << "\' is too long" << std::endl;
+            return false;
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+        listenSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenSocket < 0)
+        {
+            std::cerr << "error: socket() failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        // a socket file left behind by a previous run; anything else at the path is the user's
+        struct stat status;
+        if (lstat(socketPath.c_str(), &status) == 0)
+        {
+            if (!S_ISSOCK(status.st_mode))
+            {
+                std::cerr << "error: \'" << socketPath << "\' exists and is not a socket" << std::endl;
+                close(listenSocket);
+                listenSocket = -1;
+                return false;
+            }
+            unlink(socketPath.c_str());
+        }
+        else if (errno != ENOENT)
+        {
+            std::cerr << "error: cannot access \'" << socketPath << "\': " << std::strerror(errno) << std::endl;
+            close(listenSocket);
+            listenSocket = -1;
+            return false;
+        }
+
+        if (bind(listenSocket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(listenSocket, 16) != 0)
+        {
+            std::cerr << "error: cannot listen on \'" << socketPath << "\': " << std::strerror(errno) << std::endl;
+            close(listenSocket);
+            listenSocket = -1;
+            return false;
+        }
+        path = socketPath;
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if (epollFd < 0)
+        {
+            std::cerr << "error: epoll_create1() failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = listenSocket;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, listenSocket, &event) != 0)
+        {
+            std::cerr << "error: epoll_ctl() failed: " << std::strerror(errno) << std::endl;
+            return false;
+        }
+
+        events.resize(64);
+
+        return true;
+    }
+
+    void publish(const std::vector<std::uint8_t>& frame)
+    {
+        pollEvents();
+
+        for (size_t i = 0; i < clients.size();)
+        {
+            Client& client = clients[i];
+
+            if (!client.pending.empty())
+            {
+                ++client.droppedFrames;
+                ++droppedFrames;
+                ++i;
+                continue;
+            }
+
+            const ssize_t sent = send(client.socket, frame.data(), frame.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                disconnect(i);
+                continue;
+            }
+
+            const size_t sentBytes = 0 < sent ? static_cast<size_t>(sent) : 0;
+            if (sentBytes < frame.size())
+            {
+                // only a slow client pays for a copy of the frame
+                client.pending.assign(frame.begin() + sentBytes, frame.end());
+                client.pendingOffset = 0;
+                if (!updateEvents(client))
+                {
+                    disconnect(i);
+                    continue;
+                }
+            }
+
+            ++i;
+        }
+    }
+
+    size_t clientCount()const
+    {
+        return clients.size();
+    }
+
+    // frames skipped by slow clients in total
+    size_t dropped()const
+    {
+        return droppedFrames;
+    }
+
+private:
+
+    struct Client
+    {
+        int socket = -1;
+        std::vector<std::uint8_t> pending;
+        size_t pendingOffset = 0;
+        size_t droppedFrames = 0;
+        bool inputClosed = false;
+    };
+
+    void pollEvents()
+    {
+        const int count = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), 0);
+        for (int e = 0; e < count; ++e)
+        {
+            const int fd = events[e].data.fd;
+            if (fd == listenSocket)
+            {
+                acceptClients();
+                continue;
+            }
+
+            const size_t index = findClient(fd);
+            if (index == clients.size())
+            {
+                continue;
+            }
+
+            Client& client = clients[index];
+            const std::uint32_t flags = events[e].events;
+            if (flags & (EPOLLHUP | EPOLLERR))
+            {
+                disconnect(index);
+                continue;
+            }
+
+            // a client that only shut down its sending side may still be reading
+            if ((flags & EPOLLIN) && !discardInput(client))
+            {
+                client.inputClosed = true;
+                if (!updateEvents(client))
+                {
+                    disconnect(index);
+                    continue;
+                }
+            }
+
+            if ((flags & EPOLLOUT) && !flushPending(client))
+            {
+                disconnect(index);
+            }
+        }
+    }
+
+    void acceptClients()
+    {
+        for (;;)
+        {
+            const int socket = accept4(listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (socket < 0)
+            {
+                return;
+            }
+
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = socket;
+            if (epoll_ctl(epollFd, EPOLL_CTL_ADD, socket, &event) != 0)
+            {
+                close(socket);
+                continue;
+            }
+
+            Client client;
+            client.socket = socket;
+            clients.push_back(std::move(client));
+        }
+    }
+
+    // subscribers have nothing to say, anything they send is read and ignored;
+    // returns false at the end of their input
+    bool discardInput(Client& client)
+    {
+        char buffer[256];
+        for (;;)
+        {
+            const ssize_t size = recv(client.socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+            if (0 < size)
+            {
+                continue;
+            }
+
+            return size < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR);
+        }
+    }
+
+    // sends the rest of a frame; returns false if the client has gone
+    bool flushPending(Client& client)
+    {
+        while (client.pendingOffset < client.pending.size())
+        {
+            const ssize_t sent = send(client.socket, client.pending.data() + client.pendingOffset, client.pending.size() - client.pendingOffset, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (sent < 0)
+            {
+                return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+            }
+
+            client.pendingOffset += sent;
+        }
+
+        client.pending.clear();
+        client.pendingOffset = 0;
+
+        return updateEvents(client);
+    }
+
+    // returns false if the events of the client cannot be changed, which leaves it unserved
+    bool updateEvents(const Client& client)
+    {
+        epoll_event event = {};
+        event.events = (client.inputClosed ? 0 : EPOLLIN) | (client.pending.empty() ? 0 : EPOLLOUT);
+        event.data.fd = client.socket;
+        return epoll_ctl(epollFd, EPOLL_CTL_MOD, client.socket, &event) == 0;
+    }
+
+    size_t findClient(int socket)const
+    {
+        size_t index = 0;
+        while (index < clients.size() && clients[index].socket != socket)
+        {
+            ++index;
+        }
+        return index;
+    }
+
+    void disconnect(size_t index)
+    {
+        // close() drops the socket from the epoll set as well, so a failed EPOLL_CTL_DEL leaves nothing behind
+        if (epoll_ctl(epollFd, EPOLL_CTL_DEL, clients[index].socket, nullptr) != 0 && errno != EBADF && errno != ENOENT)
+        {
+            std::cerr << "warning: epoll_ctl() failed: " << std::strerror(errno) << std::endl;
+        }
+        close(clients[index].socket);
+
+        if (index + 1 != clients.size())
+        {
+            clients[index] = std::move(clients.back());
+        }
+        clients.pop_back();
+    }
+
+    std::string path;
+    int listenSocket = -1;
+    int epollFd = -1;
+    std::vector<epoll_event> events;
+    std::vector<Client> clients;
+    size_t droppedFrames = 0;
+};
+
+#endif
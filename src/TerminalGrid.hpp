@@ -0,0 +1,260 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <algorithm>
+
+// A block of character cells on the terminal, redrawn differentially.
+//
+// The caller sets the code of every cell each frame; update() compares them with a shadow of what the
+// terminal shows and appends only the changed cells to the output, reaching them with ANSI cursor moves.
+// A frame without changes appends nothing. The cursor is parked at the start of the last row between frames.
+// scrollDown() moves rows with the terminal's own insert and delete line, so a waterfall sends one new row.
+//
+// The first update() draws the whole block, with the borders and the footer after the last row.
+class TerminalGrid
+{
+public:
+
+    // glyphs[code] is the text of a cell, one terminal column wide; blankCode is a blank cell.
+    void init(size_t gridWidth, size_t gridHeight, const std::string_view* glyphTable, std::uint8_t blank, bool drawBorder, const std::string& footerText)
+    {
+        width = gridWidth;
+        height = gridHeight;
+        glyphs = glyphTable;
+        blankCode = blank;
+        border = drawBorder;
+        footer = footerText;
+
+        cells.assign(width * height, blankCode);
+        shown.assign(width * height, blankCode);
+        decorated.assign(height, true);
+        drawn = false;
+    }
+
+    size_t rowCount()const
+    {
+        return height;
+    }
+
+    void set(size_t row, size_t column, std::uint8_t code)
+    {
+        cells[row * width + column] = code;
+    }
+
+    // Moves rows [top, bottom) down by one on the terminal and in the grid, the last one is dropped.
+    // Row top becomes blank, to be set for this frame.
+    void scrollDown(size_t top, size_t bottom, std::string& out)
+    {
+        if (bottom <= top + 1)
+        {
+            return;
+        }
+
+        std::copy_backward(cells.begin() + top * width, cells.begin() + (bottom - 1) * width, cells.begin() + bottom * width);
+        std::fill(cells.begin() + top * width, cells.begin() + (top + 1) * width, blankCode);
+
+        if (!drawn)
+        {
+            return;
+        }
+
+        // deleting the last row first pulls up what is below the block, and the insertion pushes it back
+        moveTo(bottom - 1, 0, out);
+        out += "\x1b[M";
+        moveTo(top, 0, out);
+        out += "\x1b[L";
+
+        // terminals differ in where the column is left, so the next move sets it
+        cursorColumn = unknownColumn;
+
+        std::copy_backward(shown.begin() + top * width, shown.begin() + (bottom - 1) * width, shown.begin() + bottom * width);
+        std::fill(shown.begin() + top * width, shown.begin() + (top + 1) * width, blankCode);
+
+        // the inserted row has no borders, and the footer went with the deleted row
+        decorated[top] = false;
+        if (bottom == height)
+        {
+            decorated[height - 1] = false;
+        }
+    }
+
+    // Appends what changed since the last frame.
+    void update(std::string& out)
+    {
+        if (!drawn)
+        {
+            drawAll(out);
+            return;
+        }
+
+        for (size_t row = 0; row < height; ++row)
+        {
+            if (!decorated[row])
+            {
+                drawDecorations(row, out);
+            }
+
+            const std::uint8_t* current = cells.data() + row * width;
+            std::uint8_t* previous = shown.data() + row * width;
+
+            size_t column = 0;
+            while (column < width)
+            {
+                if (current[column] == previous[column])
+                {
+                    ++column;
+                    continue;
+                }
+
+                // a few unchanged cells cost less than a cursor move, so they are written through
+                size_t end = column + 1;
+                size_t same = 0;
+                for (size_t i = end; i < width; ++i)
+                {
+                    if (current[i] != previous[i])
+                    {
+                        end = i + 1;
+                        same = 0;
+                    }
+                    else if (maxWriteThrough < ++same)
+                    {
+                        break;
+                    }
+                }
+
+                moveTo(row, column + (border ? 1 : 0), out);
+                for (size_t i = column; i < end; ++i)
+                {
+                    out += glyphs[current[i]];
+                    previous[i] = current[i];
+                }
+                cursorColumn += end - column;
+                column = end;
+            }
+        }
+
+        moveTo(height - 1, 0, out);
+    }
+
+    // Appends the whole block as text, rows separated by '\n'.
+    void text(std::string& out)const
+    {
+        for (size_t row = 0; row < height; ++row)
+        {
+            appendRow(row, out);
+            if (row + 1 != height)
+            {
+                out += '\n';
+            }
+        }
+        out += footer;
+    }
+
+private:
+
+    static constexpr size_t maxWriteThrough = 2;
+    static constexpr size_t unknownColumn = static_cast<size_t>(-1);
+
+    void drawAll(std::string& out)
+    {
+        for (size_t row = 0; row < height; ++row)
+        {
+            appendRow(row, out);
+            if (row + 1 != height)
+            {
+                out += "\n";
+            }
+        }
+        out += footer;
+        out += "\r";
+
+        shown = cells;
+        std::fill(decorated.begin(), decorated.end(), true);
+        cursorRow = height - 1;
+        cursorColumn = 0;
+        drawn = true;
+    }
+
+    void appendRow(size_t row, std::string& out)const
+    {
+        if (border)
+        {
+            out += "│";
+        }
+        for (size_t column = 0; column < width; ++column)
+        {
+            out += glyphs[cells[row * width + column]];
+        }
+        if (border)
+        {
+            out += "│";
+        }
+    }
+
+    void drawDecorations(size_t row, std::string& out)
+    {
+        if (border)
+        {
+            moveTo(row, 0, out);
+            out += "│";
+            moveTo(row, width + 1, out);
+            out += "│";
+            cursorColumn += 1;
+        }
+        if (row + 1 == height && !footer.empty())
+        {
+            moveTo(row, width + (border ? 2 : 0), out);
+            out += footer;
+            cursorColumn += footer.size();
+        }
+        decorated[row] = true;
+    }
+
+    // cursor movements relative to the parked cursor, the column absolute (CHA)
+    void moveTo(size_t row, size_t column, std::string& out)
+    {
+        if (row < cursorRow)
+        {
+            out += "\x1b[" + std::to_string(cursorRow - row) + "A";
+        }
+        else if (cursorRow < row)
+        {
+            out += "\x1b[" + std::to_string(row - cursorRow) + "B";
+        }
+
+        if (column != cursorColumn)
+        {
+            if (column == 0)
+            {
+                out += "\r";
+            }
+            else
+            {
+                out += "\x1b[" + std::to_string(column + 1) + "G";
+            }
+        }
+
+        cursorRow = row;
+        cursorColumn = column;
+    }
+
+    size_t width = 0;
+    size_t height = 0;
+    const std::string_view* glyphs = nullptr;
+    std::uint8_t blankCode = 0;
+    bool border = false;
+    std::string footer;
+
+    // what the frame draws, and what the terminal shows
+    std::vector<std::uint8_t> cells;
+    std::vector<std::uint8_t> shown;
+    // whether the borders (and the footer of the last row) are on the terminal
+    std::vector<bool> decorated;
+    bool drawn = false;
+
+    size_t cursorRow = 0;
+    size_t cursorColumn = 0;
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <cmath>
+
+enum class WindowType
+{
+    Hamming,
+    Hann,
+    BlackmanHarris,
+    Kaiser,
+    FlatTop,
+};
+
+class WindowFunction
+{
+public:
+
+    WindowFunction() = default;
+
+    static bool Parse(const std::string& name, WindowType& type)
+    {
+        if (name == "hamming")
+        {
+            type = WindowType::Hamming;
+        }
+        else if (name == "hann")
+        {
+            type = WindowType::Hann;
+        }
+        else if (name == "blackman_harris")
+        {
+            type = WindowType::BlackmanHarris;
+        }
+        else if (name == "kaiser")
+        {
+            type = WindowType::Kaiser;
+        }
+        else if (name == "flat_top")
+        {
+            type = WindowType::FlatTop;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    // Fills a symmetric window of the given size.
+    // The table is scaled to the coherent gain of the Hamming window, so that the displayed level does not depend on the window choice.
+    static void Fill(WindowType type, float* table, size_t size, float kaiserBeta = 8.6f)
+    {
+        if (size == 1)
+        {
+            table[0] = 0.54f;
+            return;
+        }
+
+        const double pi = 3.14159265358979323846;
+
+        double sum = 0.0;
+        for (size_t i = 0; i < size; ++i)
+        {
+            const double t = 1.0 * i / (size - 1);
+            const double x = 2.0 * pi * t;
+
+            double w = 0.0;
+            switch (type)
+            {
+            case WindowType::Hamming:
+                w = 0.54 - 0.46 * std::cos(x);
+                break;
+
+            case WindowType::Hann:
+                w = 0.5 - 0.5 * std::cos(x);
+                break;
+
+            case WindowType::BlackmanHarris:
+                w = 0.35875 - 0.48829 * std::cos(x) + 0.14128 * std::cos(2.0 * x) - 0.01168 * std::cos(3.0 * x);
+                break;
+
+            case WindowType::Kaiser:
+            {
+                const double r = 2.0 * t - 1.0;
+                w = BesselI0(kaiserBeta * std::sqrt(1.0 - r * r)) / BesselI0(kaiserBeta);
+                break;
+            }
+
+            case WindowType::FlatTop:
+                w = 0.21557895 - 0.41663158 * std::cos(x) + 0.277263158 * std::cos(2.0 * x) - 0.083578947 * std::cos(3.0 * x) + 0.006947368 * std::cos(4.0 * x);
+                break;
+            }
+
+            table[i] = static_cast<float>(w);
+            sum += w;
+        }
+
+        // the cosine term of a symmetric window sums to 1
+        const double hammingSum = 0.54 * size - 0.46;
+        const float scale = static_cast<float>(hammingSum / sum);
+        for (size_t i = 0; i < size; ++i)
+        {
+            table[i] *= scale;
+        }
+    }
+
+    // The table Fill(Type, table, Size) writes, computed at compile time for analyzers whose sizes
+    // are template parameters (see FixedSpectrumAnalyzer). std::cos and std::sqrt are not constexpr,
+    // so they are replaced by series that agree with them to double precision.
+    template<WindowType Type, size_t Size>
+    static constexpr std::array<float, Size> Table(float kaiserBeta = 8.6f)
+    {
+        static_assert(0 < Size, "the window needs at least one sample");
+
+        std::array<float, Size> table{};
+        if constexpr (Size == 1)
+        {
+            table[0] = 0.54f;
+            return table;
+        }
+        else
+        {
+            const double pi = 3.14159265358979323846;
+
+            double sum = 0.0;
+            for (size_t i = 0; i < Size; ++i)
+            {
+                const double t = 1.0 * i / (Size - 1);
+                const double x = 2.0 * pi * t;
+
+                double w = 0.0;
+                if constexpr (Type == WindowType::Hamming)
+                {
+                    w = 0.54 - 0.46 * Cos(x);
+                }
+                else if constexpr (Type == WindowType::Hann)
+                {
+                    w = 0.5 - 0.5 * Cos(x);
+                }
+                else if constexpr (Type == WindowType::BlackmanHarris)
+                {
+                    w = 0.35875 - 0.48829 * Cos(x) + 0.14128 * Cos(2.0 * x) - 0.01168 * Cos(3.0 * x);
+                }
+                else if constexpr (Type == WindowType::Kaiser)
+                {
+                    const double r = 2.0 * t - 1.0;
+                    w = BesselI0(kaiserBeta * Sqrt(1.0 - r * r)) / BesselI0(kaiserBeta);
+                }
+                else
+                {
+                    w = 0.21557895 - 0.41663158 * Cos(x) + 0.277263158 * Cos(2.0 * x) - 0.083578947 * Cos(3.0 * x) + 0.006947368 * Cos(4.0 * x);
+                }
+
+                table[i] = static_cast<float>(w);
+                sum += w;
+            }
+
+            const double hammingSum = 0.54 * Size - 0.46;
+            const float scale = static_cast<float>(hammingSum / sum);
+            for (size_t i = 0; i < Size; ++i)
+            {
+                table[i] *= scale;
+            }
+
+            return table;
+        }
+    }
+
+private:
+
+    // cos(x) for x >= 0: reduced to [-pi/4, pi/4] by quarter turns, then a Taylor series
+    static constexpr double Cos(double x)
+    {
+        const double halfPi = 1.57079632679489661923;
+        const long long quarter = static_cast<long long>(x / halfPi + 0.5);
+        const double r = x - quarter * halfPi;
+        const double r2 = r * r;
+
+        double cosR = 1.0;
+        double sinR = 1.0;
+        for (int k = 13; 0 < k; --k)
+        {
+            cosR = 1.0 - r2 / ((2.0 * k - 1.0) * (2.0 * k)) * cosR;
+            sinR = 1.0 - r2 / ((2.0 * k) * (2.0 * k + 1.0)) * sinR;
+        }
+        sinR *= r;
+
+        switch (quarter & 3)
+        {
+        case 0: return cosR;
+        case 1: return -sinR;
+        case 2: return -cosR;
+        default: return sinR;
+        }
+    }
+
+    static constexpr double Sqrt(double x)
+    {
+        if (x <= 0.0)
+        {
+            return 0.0;
+        }
+
+        double y = 1.0 < x ? x : 1.0;
+        for (int i = 0; i < 64; ++i)
+        {
+            const double next = 0.5 * (y + x / y);
+            if (next == y)
+            {
+                break;
+            }
+            y = next;
+        }
+        return y;
+    }
+
+    static constexpr double BesselI0(double x)
+    {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 64; ++k)
+        {
+            const double y = x / (2.0 * k);
+            term *= y * y;
+            sum += term;
+            if (term < sum * 1.0e-12)
+            {
+                break;
+            }
+        }
+        return sum;
+    }
+};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <type_traits>
+
+// A fixed set of threads that runs the tasks of one parallel loop at a time.
+// The calling thread works on the tasks too, and run() returns when all of them are done.
+// Nothing is allocated per run, so it can be used in the frame loop.
+class WorkerPool
+{
+public:
+
+    WorkerPool() = default;
+
+    explicit WorkerPool(size_t threadCount)
+    {
+        workers.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; ++i)
+        {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskAdded.notify_all();
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    // the number of threads that share the work of run(), including the caller
+    size_t concurrency()const
+    {
+        return workers.size() + 1;
+    }
+
+    // Calls func(i) for every i in [0, taskCount).
+    template<class Func>
+    void run(size_t taskCount, Func&& func)
+    {
+        if (workers.empty() || taskCount <= 1)
+        {
+            for (size_t i = 0; i < taskCount; ++i)
+            {
+                func(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            context = const_cast<void*>(static_cast<const void*>(std::addressof(func)));
+            invoke = [](void* context, size_t index)
+            {
+                (*static_cast<std::remove_reference_t<Func>*>(context))(index);
+            };
+            nextTask = 0;
+            this->taskCount = taskCount;
+            pendingCount = taskCount;
+        }
+        taskAdded.notify_all();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (runNext(lock))
+        {
+        }
+
+        allDone.wait(lock, [this] { return pendingCount == 0; });
+    }
+
+private:
+
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            taskAdded.wait(lock, [this] { return stopping || nextTask < taskCount; });
+            if (stopping)
+            {
+                return;
+            }
+
+            runNext(lock);
+        }
+    }
+
+    // takes the next task and runs it with the lock released; returns false if there was none
+    bool runNext(std::unique_lock<std::mutex>& lock)
+    {
+        if (taskCount <= nextTask)
+        {
+            return false;
+        }
+
+        const size_t index = nextTask++;
+        void* const taskContext = context;
+        const auto taskInvoke = invoke;
+
+        lock.unlock();
+        taskInvoke(taskContext, index);
+        lock.lock();
+
+        if (--pendingCount == 0)
+        {
+            allDone.notify_all();
+        }
+
+        return true;
+    }
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable taskAdded;
+    std::condition_variable allDone;
+
+    void* context = nullptr;
+    void (*invoke)(void*, size_t) = nullptr;
+    size_t nextTask = 0;
+    size_t taskCount = 0;
+    size_t pendingCount = 0;
+    bool stopping = false;
+};
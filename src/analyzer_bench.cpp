@@ -0,0 +1,284 @@
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <iostream>
+
+#include <cxxopts.hpp>
+
+#include "SpectrumAnalyzer.hpp"
+#include "Renderer.hpp"
+
+namespace
+{
+    std::atomic<size_t> allocationCount{0};
+
+    void* Allocate(size_t size)
+    {
+        ++allocationCount;
+        if (void* p = std::malloc(size ? size : 1))
+        {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    void* AllocateAligned(size_t size, std::align_val_t alignment)
+    {
+        ++allocationCount;
+        const size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+        void* p = _aligned_malloc(size ? size : 1, align);
+#else
+        // aligned_alloc wants a multiple of the alignment
+        void* p = std::aligned_alloc(align, (size + align - 1) / align * align + (size ? 0 : align));
+#endif
+        if (p)
+        {
+            return p;
+        }
+        throw std::bad_alloc();
+    }
+
+    void FreeAligned(void* p) noexcept
+    {
+#ifdef _MSC_VER
+        _aligned_free(p);
+#else
+        std::free(p);
+#endif
+    }
+}
+
+// every allocation of the bench is counted; the nothrow forms call these
+void* operator new(size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+    return Allocate(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+    return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+    FreeAligned(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept
+{
+    FreeAligned(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept
+{
+    FreeAligned(p);
+}
+
+struct BenchResult
+{
+    size_t fftSize = 0;
+    size_t inputSize = 0;
+    size_t characterSize = 0;
+    double analyzeNs = 0.0;
+    double renderNs = 0.0;
+    double allocationsPerFrame = 0.0;
+};
+
+BenchResult RunBench(size_t fftSize, size_t inputSize, size_t characterSize, size_t frameCount, int samplingFrequency)
+{
+    using Clock = std::chrono::steady_clock;
+
+    // a few tones over some deterministic noise, longer than the input so that every frame sees new data
+    std::vector<float> buffer(inputSize * 4);
+    std::uint32_t seed = 1;
+    for (size_t i = 0; i < buffer.size(); ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const float noise = (seed >> 8) / 16777216.0f - 0.5f;
+        const float t = 1.0f * i / samplingFrequency;
+        buffer[i] = 0.3f * std::sin(2.0f * 3.1415926535f * 440.0f * t) + 0.1f * std::sin(2.0f * 3.1415926535f * 3000.0f * t) + 0.05f * noise;
+    }
+
+    SpectrumAnalyzer analyzer(inputSize, fftSize, samplingFrequency);
+    Renderer renderer(characterSize, "\r");
+
+    const float bottomLevel = -30.0f;
+    const float topLevel = -6.0f;
+    const float minFreq = 30.0f;
+    const float maxFreq = 5000.0f;
+    const float logBase = 10.0f;
+
+    const size_t hopSize = samplingFrequency / 60;
+    size_t headIndex = 0;
+
+    // warm up: builds the band plan and sizes every buffer
+    for (size_t i = 0; i < 3; ++i)
+    {
+        analyzer.update(buffer, headIndex, bottomLevel, topLevel, minFreq, maxFreq, logBase);
+        renderer.render(analyzer.spectrum(), 1, 0.5f, true);
+        headIndex = (headIndex + hopSize) % buffer.size();
+    }
+
+    Clock::duration analyzeTime{};
+    Clock::duration renderTime{};
+    const size_t allocationsBegin = allocationCount;
+
+    for (size_t i = 0; i < frameCount; ++i)
+    {
+        const auto t0 = Clock::now();
+        analyzer.update(buffer, headIndex, bottomLevel, topLevel, minFreq, maxFreq, logBase);
+        const auto t1 = Clock::now();
+        renderer.render(analyzer.spectrum(), 1, 0.5f, true);
+        const auto t2 = Clock::now();
+
+        analyzeTime += t1 - t0;
+        renderTime += t2 - t1;
+        headIndex = (headIndex + hopSize) % buffer.size();
+    }
+
+    BenchResult result;
+    result.fftSize = fftSize;
+    result.inputSize = inputSize;
+    result.characterSize = characterSize;
+    result.analyzeNs = std::chrono::duration<double, std::nano>(analyzeTime).count() / frameCount;
+    result.renderNs = std::chrono::duration<double, std::nano>(renderTime).count() / frameCount;
+    result.allocationsPerFrame = 1.0 * (allocationCount - allocationsBegin) / frameCount;
+    return result;
+}
+
+int main(int argc, const char* argv[])
+{
+    std::string format;
+    int frameCount = 0;
+    int samplingFrequency = 0;
+
+    try
+    {
+        cxxopts::Options options(argv[0], "Benchmark of the analysis and render hot paths with synthetic input");
+
+        options.add_options()
+            ("h,help", "print this message.")
+            ("format", "output format.", cxxopts::value<std::string>()->default_value("json"), "{\'json\'|\'csv\'}")
+            ("frames", "number of measured frames per configuration.", cxxopts::value<int>()->default_value("200"), "N")
+            ("sample_rate", "sampling frequency(Hz) of the synthetic input.", cxxopts::value<int>()->default_value("48000"), "N")
+            ;
+
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help"))
+        {
+            std::cout << options.help() << std::endl;
+            return 0;
+        }
+
+        format = result["format"].as<std::string>();
+        frameCount = result["frames"].as<int>();
+        samplingFrequency = result["sample_rate"].as<int>();
+
+        if (format != "json" && format != "csv")
+        {
+            std::cerr << "error: --format \'" << format << "\'" << " is invalid parameter." << std::endl;
+            std::cerr << "       format must be either 'json' or 'csv'.\n";
+            return 1;
+        }
+
+        if (frameCount <= 0 || samplingFrequency <= 0)
+        {
+            std::cerr << "error: --frames and --sample_rate must be positive." << std::endl;
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "error parsing options: " << e.what() << std::endl;
+        return 1;
+    }
+
+    const size_t characterSizes[] = {16, 64, 256};
+
+    std::vector<BenchResult> results;
+
+    for (size_t fftSize = 256; fftSize <= 65536; fftSize *= 2)
+    {
+        for (const size_t inputSize : {fftSize / 4, fftSize})
+        {
+            for (const size_t characterSize : characterSizes)
+            {
+                results.push_back(RunBench(fftSize, inputSize, characterSize, frameCount, samplingFrequency));
+            }
+        }
+    }
+
+    const auto framesPerSecond = [](const BenchResult& r)
+    {
+        return 1.0e9 / (r.analyzeNs + r.renderNs);
+    };
+
+    if (format == "csv")
+    {
+        std::cout << "fft_size,input_size,chars,kernels,analyze_ns_per_frame,render_ns_per_frame,ns_per_frame,frames_per_second,allocations_per_frame\n";
+        for (const auto& r : results)
+        {
+            std::cout << r.fftSize << "," << r.inputSize << "," << r.characterSize << "," << SpectrumKernels::GetLevelName() << ","
+                << r.analyzeNs << "," << r.renderNs << "," << (r.analyzeNs + r.renderNs) << "," << framesPerSecond(r) << "," << r.allocationsPerFrame << "\n";
+        }
+    }
+    else
+    {
+        std::cout << "[\n";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto& r = results[i];
+            std::cout << "  {\"fft_size\": " << r.fftSize
+                << ", \"input_size\": " << r.inputSize
+                << ", \"chars\": " << r.characterSize
+                << ", \"kernels\": \"" << SpectrumKernels::GetLevelName() << "\""
+                << ", \"analyze_ns_per_frame\": " << r.analyzeNs
+                << ", \"render_ns_per_frame\": " << r.renderNs
+                << ", \"ns_per_frame\": " << (r.analyzeNs + r.renderNs)
+                << ", \"frames_per_second\": " << framesPerSecond(r)
+                << ", \"allocations_per_frame\": " << r.allocationsPerFrame
+                << "}" << (i + 1 != results.size() ? "," : "") << "\n";
+        }
+        std::cout << "]\n";
+    }
+
+    return 0;
+}
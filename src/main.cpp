@@ -1,85 +1,640 @@
 #include <chrono>
-#include <thread>
+#include <sstream>
+#include <memory>
+#include <csignal>
 
 #include "SpectrumAnalyzer.hpp"
+#include "MultiChannelAnalyzer.hpp"
+#include "SlidingDftAnalyzer.hpp"
+#include "MultiResolutionAnalyzer.hpp"
 #include "Renderer.hpp"
+#ifdef ANALYZER_FIXED_CONFIG
+#include "FixedSpectrumAnalyzer.hpp"
+#include "FixedRenderer.hpp"
+#endif
+#include "FrameWriter.hpp"
+#include "SharedSpectrum.hpp"
+#include "SpectrumServer.hpp"
 #include "Axis.hpp"
 #include "Option.hpp"
 #include "SoundCapturerPulseAudio.hpp"
 #include "SoundCapturerWASAPI.hpp"
+#include "SoundCapturerStream.hpp"
+#include "SoundCapturerReplay.hpp"
+#include "SoundCapturerGenerator.hpp"
+#include "CaptureRecorder.hpp"
+#include "FrameScheduler.hpp"
+#include "FrameStats.hpp"
 
-int main(int argc, const char* argv[])
+// the first Ctrl+C ends the frame loop, so that recordings, statistics and outputs are finished; a second one kills
+inline void StopOnSignal(int signal)
 {
-#ifdef _WIN32
-    SetConsoleOutputCP(CP_UTF8);
-#endif
+    FrameScheduler::RequestStop();
+    std::signal(signal, SIG_DFL);
+}
 
-    Option option;
-    const bool suceeded = option.init(argc, argv);
-    if (!option.isInitialized())
+inline const std::vector<std::uint8_t>& EncodeFrame(FrameEncoder& encoder, const std::vector<float>& spectrum)
+{
+    const std::vector<float>* row = &spectrum;
+    return encoder.encode(&row, 1);
+}
+
+inline const std::vector<std::uint8_t>& EncodeFrame(FrameEncoder& encoder, const std::vector<const std::vector<float>*>& spectra)
+{
+    return encoder.encode(spectra);
+}
+
+template<class Capturer>
+int Run(Capturer& capturer, const Option& option, int samplingFrequency)
+{
+    if (option.channelMode == ChannelMode::MidSide && capturer.channelCount() < 2)
     {
-        return suceeded ? 0 : 1;
+        std::cerr << "error: --channel_mode mid_side requires at least 2 channels." << std::endl;
+        return 1;
     }
 
-#ifdef ANALYZER_USE_WASAPI
-    SoundCapturerWASAPI capturer;
-#else
-    SoundCapturerPulseAudio capturer;
-#endif
+    // either the FFT of every channel the mode needs, or one of the engines that consume
+    // every sample of the first channel: the sliding DFT of the tracked frequencies or the octave analysis
+    std::unique_ptr<MultiChannelAnalyzer> analyzers;
+    std::unique_ptr<SlidingDftAnalyzer> slidingDft;
+    std::unique_ptr<MultiResolutionAnalyzer> multiResolution;
+    if (option.engine == AnalyzerEngine::SlidingDft)
+    {
+        for (const float freq : option.trackedFrequencies)
+        {
+            if (samplingFrequency / 2.0f <= freq)
+            {
+                std::cerr << "error: --track_freqs \'" << freq << "\' is not below the Nyquist frequency " << samplingFrequency / 2.0f << "." << std::endl;
+                return 1;
+            }
+        }
 
-    int samplingFrequency = 48000;
-    SpectrumAnalyzer analyzer(option.inputSize, option.fftSize, samplingFrequency);
+        // as many bands as the FFT engine, so that binary frames keep their size
+        slidingDft = std::make_unique<SlidingDftAnalyzer>(option.trackedFrequencies, option.inputSize, option.fftSize - 1, samplingFrequency);
+    }
+    else if (option.engine == AnalyzerEngine::MultiResolution)
+    {
+        multiResolution = std::make_unique<MultiResolutionAnalyzer>(option.octaveFftSize, option.multiResolutionLevels(), option.fftSize - 1, samplingFrequency, option.windowType);
+    }
+    else
+    {
+        // --fft_cache restores the plan flags and the calibration of this configuration, or tunes and stores them
+        FftPlanSettings planSettings;
+        if (!option.fftCachePath.empty())
+        {
+            FftPlanCache planCache(option.fftCachePath);
+            const FftPlanCache::Key key{static_cast<size_t>(option.fftSize), static_cast<size_t>(option.inputSize), samplingFrequency, FftPlanCache::CpuFeatures()};
+            if (!planCache.find(key, planSettings))
+            {
+                planSettings.flags = FftPlanCache::TunePlanFlags(option.fftSize);
+                analyzers = std::make_unique<MultiChannelAnalyzer>(option.channelMode, capturer.channelCount(), option.inputSize, option.fftSize, samplingFrequency, option.windowType, planSettings);
+                planCache.insert(key, analyzers->primary().fftPlanSettings());
+            }
+        }
 
-    if (option.displayAxis)
+        if (!analyzers)
+        {
+            analyzers = std::make_unique<MultiChannelAnalyzer>(option.channelMode, capturer.channelCount(), option.inputSize, option.fftSize, samplingFrequency, option.windowType, planSettings);
+        }
+    }
+
+    const auto withSampleEngine = [&](const auto& func)
     {
-        Axis::PrintAxis(option.characterSize, analyzer.getLabels(option.minFreq, option.maxFreq, option.axisLogBase));
+        if (slidingDft)
+        {
+            func(*slidingDft);
+        }
+        else if (multiResolution)
+        {
+            func(*multiResolution);
+        }
+    };
 
-        std::cout << "_/> " << option.topLevel << " [dB]\n";
+    // the first profile is view 0 of the analyzers, every further one adds a view of the same analysis
+    const auto& profiles = option.profiles;
+    const OutputProfile& mainProfile = profiles[0];
+    for (size_t i = 1; i < profiles.size(); ++i)
+    {
+        if (analyzers)
+        {
+            analyzers->addView(profiles[i].bottomLevel, profiles[i].topLevel, profiles[i].minFreq, profiles[i].maxFreq, profiles[i].axisLogBase);
+        }
+
+        withSampleEngine([&](auto& engine)
+        {
+            engine.addView(profiles[i].bottomLevel, profiles[i].topLevel, profiles[i].minFreq, profiles[i].maxFreq, profiles[i].axisLogBase);
+        });
     }
 
-    Renderer renderer(option.characterSize, option.lineFeed);
+    // those engines draw a single line per view
+    std::vector<std::vector<const std::vector<float>*>> engineRows;
+    withSampleEngine([&](auto& engine)
+    {
+        for (size_t view = 0; view < engine.viewCount(); ++view)
+        {
+            engineRows.push_back({&engine.spectrum(view)});
+        }
+    });
 
-    if (!capturer.init(option.inputSize, samplingFrequency))
+    const auto spectra = [&](size_t view) -> const std::vector<const std::vector<float>*>&
+    {
+        return analyzers ? analyzers->spectra(view) : engineRows[view];
+    };
+
+    const bool binary = option.outputFormat == OutputFormat::Binary;
+    const bool text = option.outputFormat == OutputFormat::Text;
+
+    // text output draws each profile with a Renderer, binary output skips rendering altogether
+    std::vector<std::unique_ptr<Renderer>> renderers;
+    std::vector<std::unique_ptr<FrameWriter>> writers;
+    for (const auto& profile : profiles)
+    {
+        if (!text && !binary)
+        {
+            continue;
+        }
+
+        if (binary)
+        {
+            auto writer = std::make_unique<FrameWriter>(option.binaryFormat, samplingFrequency);
+            if (!profile.outputPath.empty() && !writer->open(profile.outputPath))
+            {
+                return 1;
+            }
+
+            writers.push_back(std::move(writer));
+            continue;
+        }
+
+        auto renderer = std::make_unique<Renderer>(profile.characterSize, profile.lineFeed, profile.renderMode, profile.rows);
+        if (!profile.outputPath.empty() && !renderer->open(profile.outputPath))
+        {
+            return 1;
+        }
+
+        if (profile.displayAxis)
+        {
+            std::stringstream header;
+            Axis::PrintAxis(profile.characterSize, SpectrumAnalyzer::GetLabels(profile.minFreq, profile.maxFreq, profile.axisLogBase), header);
+            header << "_/> " << profile.topLevel << " [dB]\n";
+            renderer->write(header.str());
+
+            std::stringstream footer;
+            footer << "_/> " << profile.bottomLevel << " [dB]";
+            renderer->setFooter(footer.str());
+        }
+
+        renderers.push_back(std::move(renderer));
+    }
+
+#ifndef _WIN32
+    SharedSpectrumWriter sharedSpectrum;
+    const bool shared = !option.shmName.empty();
+    if (shared)
+    {
+        const size_t rowCount = spectra(0).size();
+        const size_t maxValues = rowCount * (option.fftSize - 1);
+        const size_t lineCount = rowCount * (mainProfile.renderMode == RenderMode::Line ? 1 : mainProfile.rows);
+        const size_t maxLineBytes = lineCount * (mainProfile.characterSize + 3) * 3 + 64;
+        if (!sharedSpectrum.open(option.shmName, maxValues, maxLineBytes))
+        {
+            return 1;
+        }
+    }
+#endif
+
+#ifdef __linux__
+    SpectrumServer server;
+    FrameEncoder serverEncoder(option.binaryFormat, samplingFrequency);
+    const bool serving = !option.socketPath.empty();
+    if (serving && !server.open(option.socketPath))
     {
         return 1;
     }
+#endif
 
-    const float maxFPS = 60.0f;
+#ifdef ANALYZER_STATS
+    // --stats times the stages of every frame, see FrameStats
+    FrameStats frameStats;
+    FrameStats* stats = nullptr;
+    if (!option.statsPath.empty())
+    {
+        if (!frameStats.open(option.statsPath, option.statsInterval))
+        {
+            return 1;
+        }
 
-    const float millisecPerFrame = 1000.0f / maxFPS;
+        stats = &frameStats;
+        if (analyzers)
+        {
+            analyzers->setStats(stats);
+        }
+        for (auto& renderer : renderers)
+        {
+            renderer->setStats(stats);
+        }
+    }
+#endif
+
+    // --record keeps what every frame reads, for --source replay
+    CaptureRecorder recorder;
+    const bool recording = !option.recordPath.empty();
+    if (recording && !recorder.open(option.recordPath, samplingFrequency, capturer.channelCount(), capturer.getBuffer().size()))
+    {
+        return 1;
+    }
 
-    for (int i = 0;;)
+    // publishes the first profile after it has been drawn
+    const auto publish = [&](const auto& spectra)
     {
-        const auto t1 = std::chrono::high_resolution_clock::now();
+        ANALYZER_STATS_SCOPE(stats, Stage::Output);
+#ifndef _WIN32
+        if (shared)
+        {
+            sharedSpectrum.write(spectra, samplingFrequency, text ? renderers[0]->frameText() : std::string_view());
+        }
+#endif
+#ifdef __linux__
+        if (serving)
+        {
+            // serialized once, whatever the number of clients
+            server.publish(EncodeFrame(serverEncoder, spectra));
+        }
+#endif
+    };
 
-        capturer.update();
+    // with the STFT, --hop is the analysis hop and frames are drawn at --fps
+    const bool stft = option.stftMode != StftMode::Off;
+    FrameScheduler scheduler(option.fps, stft ? 0 : option.frameHopSize(samplingFrequency), option.realtime);
 
-        if (option.inputSize < capturer.bufferReadCount())
+#ifdef ANALYZER_STATS
+    scheduler.setStats(stats);
+
+    // frames skipped by the scheduler, and by the STFT when the buffer has moved past them
+    const auto droppedFrames = [&]()
+    {
+        return scheduler.droppedFrames() + (stft ? analyzers->primary().stftDroppedFrames() : 0);
+    };
+    size_t lastReadCount = 0;
+    size_t lastFrameCount = 0;
+#endif
+
+    if (option.lowLatency)
+    {
+        // what the capture and the scheduling cannot remove: the newest sample is at the end of the window
+        std::cerr << "low latency: a frame every " << option.frameHopSize(samplingFrequency) << " samples as they arrive, the window spans "
+            << 1000.0 * option.inputSize / samplingFrequency << " ms of input. --stats reports the measured latency." << std::endl;
+    }
+
+    const auto drawProfile = [&](size_t index)
+    {
+        const auto& profile = profiles[index];
+        if (binary)
+        {
+            ANALYZER_STATS_SCOPE(stats, Stage::Output);
+            writers[index]->write(spectra(index));
+        }
+        else if (text)
         {
-            analyzer.update(capturer.getBuffer(), capturer.bufferHeadIndex(), option.bottomLevel, option.topLevel, option.minFreq, option.maxFreq, option.axisLogBase);
+            renderers[index]->draw(spectra(index), profile.windowSize, profile.smoothing, profile.displayAxis);
+        }
 
-            renderer.draw(analyzer.spectrum(), option.windowSize, option.smoothing, option.displayAxis);
+        if (index == 0)
+        {
+            publish(spectra(0));
+        }
+    };
+
+    const auto drawFrame = [&]()
+    {
+        for (size_t i = 0; i < profiles.size(); ++i)
+        {
+            drawProfile(i);
+        }
+    };
+
+    // with --stft each, every frame is drawn for the first profile and the latest one for the others
+    const auto drawStftFrame = [&](const std::vector<float>& spectrum)
+    {
+        if (binary)
+        {
+            ANALYZER_STATS_SCOPE(stats, Stage::Output);
+            writers[0]->write(spectrum);
+        }
+        else if (text)
+        {
+            renderers[0]->draw(spectrum, mainProfile.windowSize, mainProfile.smoothing, mainProfile.displayAxis);
+        }
+
+        publish(spectrum);
+    };
+
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    size_t frameCount = 0;
+    while (scheduler.waitNextFrame(capturer))
+    {
+        if (recording && !recorder.write(capturer, CaptureRecorder::Clock::now()))
+        {
+            return 1;
+        }
+
+#ifdef ANALYZER_STATS
+        if (stats)
+        {
+            stats->recordBacklog(capturer.bufferReadCount() - lastReadCount);
+            lastReadCount = capturer.bufferReadCount();
+        }
+#endif
+
+        {
+            ANALYZER_STATS_SCOPE(stats, Stage::Frame);
 
-            if (option.displayAxis)
+            if (stft)
             {
-                std::cout << "_/> " << option.bottomLevel << " [dB]";
-            }
+                const auto aggregate = option.stftMode == StftMode::Max ? StftAggregate::Max : (option.stftMode == StftMode::Mean ? StftAggregate::Mean : StftAggregate::Latest);
+                const auto updateStft = [&](const auto& onFrame)
+                {
+                    return analyzers->primary().updateStft(capturer.getBuffer(), capturer.bufferHeadIndex(), capturer.bufferReadCount(), option.stftHopSize(), aggregate,
+                        mainProfile.bottomLevel, mainProfile.topLevel, mainProfile.minFreq, mainProfile.maxFreq, mainProfile.axisLogBase, onFrame);
+                };
+                const size_t count = option.stftMode == StftMode::Each ? updateStft(drawStftFrame) : updateStft(nullptr);
 
-            std::cout << std::flush;
+                if (count != 0)
+                {
+                    for (size_t i = option.stftMode == StftMode::Each ? 1 : 0; i < profiles.size(); ++i)
+                    {
+                        drawProfile(i);
+                    }
+                }
 
-            const auto t2 = std::chrono::high_resolution_clock::now();
+                frameCount += count;
+            }
+            else if (!analyzers)
+            {
+                // every sample read since the last frame, so there is no window to fill first
+                withSampleEngine([&](auto& engine)
+                {
+                    ANALYZER_STATS_SCOPE(stats, Stage::Fft);
+                    engine.update(capturer.getBuffer(), capturer.bufferHeadIndex(), capturer.bufferReadCount(),
+                        mainProfile.bottomLevel, mainProfile.topLevel, mainProfile.minFreq, mainProfile.maxFreq, mainProfile.axisLogBase);
+                });
 
-            std::chrono::duration<float, std::milli> elapsed = t2 - t1;
+                drawFrame();
 
-            if (elapsed.count() < millisecPerFrame)
+                ++frameCount;
+            }
+            else if (option.inputSize < capturer.bufferReadCount())
             {
-                const int millisecSleep = static_cast<int>(millisecPerFrame - elapsed.count());
-                std::this_thread::sleep_for(std::chrono::milliseconds(millisecSleep));
+                analyzers->update(capturer, mainProfile.bottomLevel, mainProfile.topLevel, mainProfile.minFreq, mainProfile.maxFreq, mainProfile.axisLogBase);
+
+                drawFrame();
+
+                ++frameCount;
             }
+        }
+
+#ifdef ANALYZER_STATS
+        // from the capture of the newest sample the frame analyzed to the end of its output
+        if (stats && frameCount != lastFrameCount)
+        {
+            stats->recordLatency(FrameStats::Clock::now() - capturer.latestSampleTime(), capturer.deviceLatency());
+            lastFrameCount = frameCount;
+        }
+#endif
+
+        scheduler.frameDone(capturer.bufferReadCount());
+
+#ifdef ANALYZER_STATS
+        if (stats)
+        {
+            stats->frameDone(scheduler.lateFrames(), droppedFrames());
+        }
+#endif
+    }
+
+#ifdef ANALYZER_STATS
+    if (stats)
+    {
+        stats->finish(scheduler.lateFrames(), droppedFrames());
+    }
+#endif
+
+    if (recording && !recorder.close())
+    {
+        return 1;
+    }
+
+    if (!option.realtime)
+    {
+        const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        const double audioSeconds = 1.0 * capturer.bufferReadCount() / samplingFrequency;
+
+        if (text)
+        {
+            std::cout << std::endl;
+        }
+        std::cerr << "processed " << frameCount << " frames (" << audioSeconds << " s of audio) in " << elapsed.count() << " s: "
+            << frameCount / elapsed.count() << " frames/s, " << audioSeconds / elapsed.count() << "x realtime" << std::endl;
+#ifdef __linux__
+        if (serving)
+        {
+            std::cerr << "server: " << server.clientCount() << " clients connected, " << server.dropped() << " frames dropped by slow clients" << std::endl;
+        }
+#endif
+    }
 
-            ++i;
+    return 0;
+}
+
+#ifdef ANALYZER_FIXED_CONFIG
+// Run() for the configuration this build is specialized for, checked by Option:
+// one text line of the first channel, drawn with fixed-size buffers.
+template<class Capturer>
+int RunFixed(Capturer& capturer, const Option& option, int samplingFrequency)
+{
+    // as many bands as Run() draws
+    using Analyzer = FixedSpectrumAnalyzer<ANALYZER_FIXED_FFT_SIZE, ANALYZER_FIXED_INPUT_SIZE, ANALYZER_FIXED_FFT_SIZE - 1, WindowType::ANALYZER_FIXED_WINDOW>;
+
+    // static storage keeps the FFT buffers off the stack
+    static Analyzer analyzer;
+    analyzer.init(samplingFrequency);
+
+    const OutputProfile& profile = option.profiles[0];
+    FixedRenderer<ANALYZER_FIXED_CHARS> renderer(profile.lineFeed);
+    if (!profile.outputPath.empty() && !renderer.open(profile.outputPath))
+    {
+        return 1;
+    }
+
+    if (profile.displayAxis)
+    {
+        std::stringstream header;
+        Axis::PrintAxis(profile.characterSize, SpectrumAnalyzer::GetLabels(profile.minFreq, profile.maxFreq, profile.axisLogBase), header);
+        header << "_/> " << profile.topLevel << " [dB]\n";
+        renderer.write(header.str());
+
+        std::stringstream footer;
+        footer << "_/> " << profile.bottomLevel << " [dB]";
+        renderer.setFooter(footer.str());
+    }
+
+    CaptureRecorder recorder;
+    const bool recording = !option.recordPath.empty();
+    if (recording && !recorder.open(option.recordPath, samplingFrequency, capturer.channelCount(), capturer.getBuffer().size()))
+    {
+        return 1;
+    }
+
+    FrameScheduler scheduler(option.fps, option.frameHopSize(samplingFrequency), option.realtime);
+
+    const auto startTime = std::chrono::high_resolution_clock::now();
+
+    size_t frameCount = 0;
+    while (scheduler.waitNextFrame(capturer))
+    {
+        if (recording && !recorder.write(capturer, CaptureRecorder::Clock::now()))
+        {
+            return 1;
+        }
+
+        if (option.inputSize < capturer.bufferReadCount())
+        {
+            analyzer.update(capturer.getBuffer(), capturer.bufferHeadIndex(), profile.bottomLevel, profile.topLevel, profile.minFreq, profile.maxFreq, profile.axisLogBase);
+
+            renderer.draw(analyzer.spectrum(), profile.windowSize, profile.smoothing, profile.displayAxis);
+
+            ++frameCount;
         }
+
+        scheduler.frameDone(capturer.bufferReadCount());
+    }
+
+    if (recording && !recorder.close())
+    {
+        return 1;
+    }
+
+    if (!option.realtime)
+    {
+        const std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - startTime;
+        const double audioSeconds = 1.0 * capturer.bufferReadCount() / samplingFrequency;
+
+        std::cout << std::endl;
+        std::cerr << "processed " << frameCount << " frames (" << audioSeconds << " s of audio) in " << elapsed.count() << " s: "
+            << frameCount / elapsed.count() << " frames/s, " << audioSeconds / elapsed.count() << "x realtime" << std::endl;
     }
 
     return 0;
 }
+#endif
+
+int main(int argc, const char* argv[])
+{
+#ifdef _WIN32
+    SetConsoleOutputCP(CP_UTF8);
+#endif
+
+    Option option;
+    const bool suceeded = option.init(argc, argv);
+    if (!option.isInitialized())
+    {
+        return suceeded ? 0 : 1;
+    }
+
+    std::signal(SIGINT, StopOnSignal);
+    std::signal(SIGTERM, StopOnSignal);
+
+    if (option.source == CaptureSource::Stdin)
+    {
+        SoundCapturerStream capturer(option.streamFormat, option.channels);
+
+        if (!capturer.init(option.captureBufferSize(option.samplingFrequency), option.samplingFrequency))
+        {
+            return 1;
+        }
+
+        // one hop per frame keeps the realtime mode paced by the audio clock
+        capturer.setHopSize(0 < option.hopSize && option.stftMode == StftMode::Off ? option.hopSize : static_cast<size_t>(capturer.samplingFrequency() / option.fps));
+
+#ifdef ANALYZER_FIXED_CONFIG
+        return RunFixed(capturer, option, capturer.samplingFrequency());
+#else
+        return Run(capturer, option, capturer.samplingFrequency());
+#endif
+    }
+
+    if (option.source == CaptureSource::Generator)
+    {
+        SoundCapturerGenerator capturer(option.signal, option.channels, option.signalSpeed, option.signalDuration, option.realtime);
+
+        if (!capturer.init(option.captureBufferSize(option.samplingFrequency), option.samplingFrequency))
+        {
+            return 1;
+        }
+
+        // without realtime, one hop per frame like the stdin source
+        capturer.setHopSize(0 < option.hopSize && option.stftMode == StftMode::Off ? option.hopSize : static_cast<size_t>(option.samplingFrequency / option.fps));
+
+#ifdef ANALYZER_FIXED_CONFIG
+        return RunFixed(capturer, option, option.samplingFrequency);
+#else
+        return Run(capturer, option, option.samplingFrequency);
+#endif
+    }
+
+    if (option.source == CaptureSource::Replay)
+    {
+        // the recording brings its own sample rate, channels and buffer size, and one frame per block
+        SoundCapturerReplay capturer(option.replayPath, option.realtime);
+
+        if (!capturer.init())
+        {
+            return 1;
+        }
+
+        // --engine fft reads input_size samples back, and --stft a hop more, so a smaller buffer would draw nothing
+        const size_t requiredSize = option.captureBufferSize(capturer.samplingFrequency());
+        if (option.engine == AnalyzerEngine::Fft && capturer.getBuffer().size() < requiredSize)
+        {
+            std::cerr << "error: \'" << option.replayPath << "\' was recorded with a capture buffer of " << capturer.getBuffer().size()
+                << " samples and these options need " << requiredSize << ". record it with the options of the replay." << std::endl;
+            return 1;
+        }
+
+#ifdef ANALYZER_FIXED_CONFIG
+        return RunFixed(capturer, option, capturer.samplingFrequency());
+#else
+        return Run(capturer, option, capturer.samplingFrequency());
+#endif
+    }
+
+#if defined(ANALYZER_USE_WASAPI)
+    SoundCapturerWASAPI capturer(option.channels);
+#elif defined(ANALYZER_USE_PULSEAUDIO)
+    SoundCapturerPulseAudio capturer(option.channels);
+#endif
+
+#if defined(ANALYZER_USE_WASAPI) || defined(ANALYZER_USE_PULSEAUDIO)
+    capturer.setLowLatency(option.lowLatency);
+
+    // the buffer is sized once the rate of the device is known
+    const auto bufferSize = [&](int sampleRate)
+    {
+        return option.captureBufferSize(sampleRate);
+    };
+    if (!capturer.init(bufferSize, option.samplingFrequency))
+    {
+        return 1;
+    }
+
+#ifdef ANALYZER_FIXED_CONFIG
+    return RunFixed(capturer, option, capturer.samplingFrequency());
+#else
+    return Run(capturer, option, capturer.samplingFrequency());
+#endif
+#else
+    std::cerr << "error: no audio device backend is available in this build, use --source stdin." << std::endl;
+    return 1;
+#endif
+}
@@ -0,0 +1,86 @@
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include <algorithm>
+
+#include <cxxopts.hpp>
+
+#include "SharedSpectrum.hpp"
+
+// Example reader of the spectrum that `analyzer --shm NAME` publishes.
+// Polls the segment and prints each new frame, either as the rendered text or as a summary of the values.
+int main(int argc, const char* argv[])
+{
+    std::string name;
+    std::string print;
+    int intervalMs = 0;
+
+    try
+    {
+        cxxopts::Options options(argv[0], "Example reader of the spectrum published by analyzer --shm");
+
+        options.add_options()
+            ("h,help", "print this message.")
+            ("shm", "POSIX shared memory name given to analyzer --shm.", cxxopts::value<std::string>()->default_value("/analyzer"), "NAME")
+            ("print", "print the rendered 'line' (empty unless analyzer draws text), or a summary of the 'values'.", cxxopts::value<std::string>()->default_value("line"), "{\'line\'|\'values\'}")
+            ("interval", "polling interval in milliseconds.", cxxopts::value<int>()->default_value("16"), "N")
+            ;
+
+        auto result = options.parse(argc, argv);
+
+        if (result.count("help"))
+        {
+            std::cout << options.help() << std::endl;
+            return 0;
+        }
+
+        name = result["shm"].as<std::string>();
+        print = result["print"].as<std::string>();
+        intervalMs = result["interval"].as<int>();
+
+        if (print != "line" && print != "values")
+        {
+            std::cerr << "error: --print \'" << print << "\'" << " is invalid parameter." << std::endl;
+            std::cerr << "       print must be either 'line' or 'values'.\n";
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "error parsing options: " << e.what() << std::endl;
+        return 1;
+    }
+
+    SharedSpectrumReader reader;
+    if (!reader.open(name))
+    {
+        return 1;
+    }
+
+    std::vector<float> values;
+    std::string line;
+    std::uint64_t frameIndex = 0;
+    std::uint32_t bandCount = 0;
+    std::uint64_t lastSequence = 0;
+
+    for (;;)
+    {
+        // reading the sequence costs no system call, only copy a frame when there is a new one;
+        // lastSequence is that of the copied frame, so a frame published after read() is not skipped
+        if (reader.sequence() != lastSequence && reader.read(values, &line, &frameIndex, &bandCount, &lastSequence))
+        {
+            if (print == "line")
+            {
+                std::cout << line << std::endl;
+            }
+            else if (!values.empty() && bandCount != 0)
+            {
+                const auto peak = std::max_element(values.begin(), values.begin() + bandCount);
+                std::cout << "frame " << frameIndex << ": " << values.size() / bandCount << " x " << bandCount << " values, peak "
+                    << *peak << " at band " << (peak - values.begin()) << std::endl;
+            }
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+    }
+}
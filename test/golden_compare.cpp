@@ -0,0 +1,209 @@
+#include <vector>
+#include <string>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <algorithm>
+
+#include "FrameWriter.hpp"
+
+// Compares the output of analyzer with a golden file, allowing for the rounding of the FFT build.
+//
+//   golden_compare OUTPUT GOLDEN
+//
+// Binary frames (see FrameEncoder) must have the same headers, but for timestampNs, the time they were
+// written. Their float32 values may differ by MaxValueDifference of the display range, uint8 values by one.
+// Text must be the same byte by byte, but for Braille bars, each of whose two columns may be a dot higher
+// or lower: the muFFT plan and the kernel level round differently, which moves a bar near a dot threshold.
+
+namespace
+{
+    constexpr float MaxValueDifference = 1.0e-3f;
+
+    int failureCount = 0;
+
+    void Fail(const std::string& what)
+    {
+        if (++failureCount <= 20)
+        {
+            std::cerr << "FAIL " << what << std::endl;
+        }
+    }
+
+    bool ReadFile(const char* path, std::vector<std::uint8_t>& data)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            std::cerr << "error: cannot open '" << path << "'" << std::endl;
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    bool IsBinary(const std::vector<std::uint8_t>& data)
+    {
+        return sizeof(FrameEncoder::FrameHeader) <= data.size() && std::memcmp(data.data(), "MSAF", 4) == 0;
+    }
+
+    void CompareFrames(const std::vector<std::uint8_t>& output, const std::vector<std::uint8_t>& golden)
+    {
+        using FrameHeader = FrameEncoder::FrameHeader;
+
+        size_t offset = 0;
+        size_t frameIndex = 0;
+        for (; offset < golden.size(); ++frameIndex)
+        {
+            FrameHeader expected;
+            FrameHeader actual;
+            if (golden.size() < offset + sizeof(FrameHeader) || output.size() < offset + sizeof(FrameHeader))
+            {
+                Fail("frame " + std::to_string(frameIndex) + " is truncated");
+                return;
+            }
+            std::memcpy(&expected, golden.data() + offset, sizeof(FrameHeader));
+            std::memcpy(&actual, output.data() + offset, sizeof(FrameHeader));
+
+            if (std::memcmp(actual.magic, expected.magic, 4) != 0 || actual.headerSize != expected.headerSize || actual.sequence != expected.sequence
+                || actual.sampleRate != expected.sampleRate || actual.bandCount != expected.bandCount || actual.rowCount != expected.rowCount
+                || actual.valueFormat != expected.valueFormat)
+            {
+                Fail("the header of frame " + std::to_string(frameIndex) + " differs");
+                return;
+            }
+
+            const size_t valueCount = static_cast<size_t>(expected.rowCount) * expected.bandCount;
+            const size_t valueBytes = expected.valueFormat == 0 ? sizeof(float) : sizeof(std::uint8_t);
+            const size_t valuesOffset = offset + expected.headerSize;
+            if (golden.size() < valuesOffset + valueCount * valueBytes || output.size() < valuesOffset + valueCount * valueBytes)
+            {
+                Fail("the values of frame " + std::to_string(frameIndex) + " are truncated");
+                return;
+            }
+
+            for (size_t i = 0; i < valueCount; ++i)
+            {
+                float a;
+                float b;
+                if (expected.valueFormat == 0)
+                {
+                    std::memcpy(&a, output.data() + valuesOffset + i * sizeof(float), sizeof(float));
+                    std::memcpy(&b, golden.data() + valuesOffset + i * sizeof(float), sizeof(float));
+                }
+                else
+                {
+                    a = output[valuesOffset + i];
+                    b = golden[valuesOffset + i];
+                }
+
+                const float maxDifference = expected.valueFormat == 0 ? MaxValueDifference : 1.0f;
+                if (!(std::abs(a - b) <= maxDifference))
+                {
+                    Fail("frame " + std::to_string(frameIndex) + " band " + std::to_string(i) + ": " + std::to_string(a) + " instead of " + std::to_string(b));
+                }
+            }
+
+            offset = valuesOffset + valueCount * valueBytes;
+        }
+
+        if (output.size() != offset)
+        {
+            Fail(std::to_string(frameIndex) + " frames expected, the output has " + std::to_string(output.size() - offset) + " more bytes");
+        }
+    }
+
+    // the dot bits of a UTF-8 Braille pattern (U+2800-U+28FF) at data[i], or -1
+    int BrailleBits(const std::vector<std::uint8_t>& data, size_t i)
+    {
+        if (i + 3 <= data.size() && data[i] == 0xe2 && (data[i + 1] & 0xfc) == 0xa0 && (data[i + 2] & 0xc0) == 0x80)
+        {
+            return ((data[i + 1] & 0x03) << 6) | (data[i + 2] & 0x3f);
+        }
+        return -1;
+    }
+
+    // dots 1, 2, 3 and 7 are the left column, 4, 5, 6 and 8 the right one
+    int LeftDots(int bits)
+    {
+        return ((bits >> 0) & 1) + ((bits >> 1) & 1) + ((bits >> 2) & 1) + ((bits >> 6) & 1);
+    }
+
+    int RightDots(int bits)
+    {
+        return ((bits >> 3) & 1) + ((bits >> 4) & 1) + ((bits >> 5) & 1) + ((bits >> 7) & 1);
+    }
+
+    void CompareText(const std::vector<std::uint8_t>& output, const std::vector<std::uint8_t>& golden)
+    {
+        if (output.size() != golden.size())
+        {
+            Fail("the output has " + std::to_string(output.size()) + " bytes instead of " + std::to_string(golden.size()));
+            return;
+        }
+
+        for (size_t i = 0; i < golden.size(); ++i)
+        {
+            if (output[i] == golden[i])
+            {
+                continue;
+            }
+
+            // a Braille pattern is 3 bytes, the differing one may be any of them
+            size_t patternStart = golden.size();
+            for (size_t j = i - std::min<size_t>(i, 2); j <= i; ++j)
+            {
+                if (0 <= BrailleBits(golden, j) && j + 3 > i)
+                {
+                    patternStart = j;
+                    break;
+                }
+            }
+
+            const int expected = patternStart < golden.size() ? BrailleBits(golden, patternStart) : -1;
+            const int actual = patternStart < golden.size() ? BrailleBits(output, patternStart) : -1;
+            if (expected < 0 || actual < 0 || 1 < std::abs(LeftDots(actual) - LeftDots(expected)) || 1 < std::abs(RightDots(actual) - RightDots(expected)))
+            {
+                Fail("byte " + std::to_string(i) + " differs");
+            }
+
+            i = patternStart < golden.size() ? patternStart + 2 : i;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "usage: golden_compare OUTPUT GOLDEN" << std::endl;
+        return 2;
+    }
+
+    std::vector<std::uint8_t> output;
+    std::vector<std::uint8_t> golden;
+    if (!ReadFile(argv[1], output) || !ReadFile(argv[2], golden))
+    {
+        return 2;
+    }
+
+    if (IsBinary(golden))
+    {
+        CompareFrames(output, golden);
+    }
+    else
+    {
+        CompareText(output, golden);
+    }
+
+    if (failureCount != 0)
+    {
+        std::cerr << argv[1] << " differs from " << argv[2] << " in " << failureCount << " places" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
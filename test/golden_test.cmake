@@ -0,0 +1,56 @@
+# Replays a recording through analyzer and compares its stdout with a golden file using golden_compare.
+#
+#   cmake -DANALYZER=<path> -DCOMPARE=<golden_compare> -DREPLAY=<recording> -DOUTPUT=<file> [-DARGS="<options>"]
+#         [-DGOLDEN=<file> [-DUPDATE=ON]] [-DFRAME_BUDGET_US=<us> -DSTATS=<file>] -P golden_test.cmake
+#
+# With UPDATE, the output replaces the golden file instead. With FRAME_BUDGET_US, analyzer also runs
+# with --stats=STATS and the test fails if the p99 of the frame stage exceeds it.
+
+cmake_minimum_required(VERSION 3.16)
+
+foreach (variable ANALYZER REPLAY OUTPUT)
+    if (NOT DEFINED ${variable})
+        message(FATAL_ERROR "${variable} is not set")
+    endif ()
+endforeach ()
+
+separate_arguments(options UNIX_COMMAND "${ARGS}")
+set(command "${ANALYZER}" --source replay --replay "${REPLAY}" --realtime off ${options})
+if (DEFINED FRAME_BUDGET_US)
+    # --stats appends, so only this run is in the file
+    file(REMOVE "${STATS}")
+    list(APPEND command "--stats=${STATS}")
+endif ()
+
+execute_process(COMMAND ${command} OUTPUT_FILE "${OUTPUT}" RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "analyzer exited with ${result}")
+endif ()
+
+if (NOT DEFINED GOLDEN)
+elseif (UPDATE)
+    configure_file("${OUTPUT}" "${GOLDEN}" COPYONLY)
+    message(STATUS "updated ${GOLDEN}")
+else ()
+    execute_process(COMMAND "${COMPARE}" "${OUTPUT}" "${GOLDEN}" RESULT_VARIABLE result)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "${OUTPUT} differs from ${GOLDEN}")
+    endif ()
+endif ()
+
+if (DEFINED FRAME_BUDGET_US)
+    # the summary at exit is the last one; its frame line is "frame <count> <p50> <p99> <max>"
+    file(STRINGS "${STATS}" frameLines REGEX "^  frame ")
+    if (NOT frameLines)
+        message(FATAL_ERROR "${STATS} has no frame timings")
+    endif ()
+    list(GET frameLines -1 frameLine)
+    string(STRIP "${frameLine}" frameLine)
+    string(REGEX REPLACE " +" ";" frameFields "${frameLine}")
+    list(GET frameFields 3 p99)
+
+    message(STATUS "frame p99 ${p99} us, budget ${FRAME_BUDGET_US} us")
+    if (p99 GREATER FRAME_BUDGET_US)
+        message(FATAL_ERROR "the frame p99 of ${p99} us exceeds the budget of ${FRAME_BUDGET_US} us")
+    endif ()
+endif ()
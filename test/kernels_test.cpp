@@ -0,0 +1,268 @@
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include "SpectrumKernels.hpp"
+
+// Runs every kernel of SpectrumKernels at each dispatch level the CPU supports, on random and edge inputs,
+// and checks them against a double precision reference within the error bound documented for Log10:
+// 4e-6 in log10, i.e. 4e-5 dB on the 10*log10 scale of powers. S16ToFloat must match a division by 32767 exactly.
+
+namespace
+{
+    constexpr double MaxErrorDb = 4.0e-5;
+
+    // lengths with and without a remainder for the scalar tail of the vector loops
+    constexpr size_t Lengths[] = {1, 3, 7, 8, 9, 16, 31, 257, 1031};
+
+    int failureCount = 0;
+
+    void Expect(bool condition, const char* level, const char* kernel, const std::string& what)
+    {
+        if (!condition)
+        {
+            if (++failureCount <= 20)
+            {
+                std::cerr << "FAIL " << level << " " << kernel << ": " << what << std::endl;
+            }
+        }
+    }
+
+    // the difference in dB of two powers (scale 10) or amplitudes (scale 20); both non-normal counts as equal
+    double DifferenceDb(double value, double reference, double scale)
+    {
+        const double minNormal = std::numeric_limits<float>::min();
+        if (value < minNormal && reference < minNormal)
+        {
+            return 0.0;
+        }
+        if (std::isinf(value) && std::isinf(reference))
+        {
+            return 0.0;
+        }
+        return std::abs(scale * std::log10(value / reference));
+    }
+
+    // powers of 2 from denormal to overflow, and their neighbours
+    std::vector<float> EdgeValues()
+    {
+        std::vector<float> values = {
+            0.0f,
+            std::numeric_limits<float>::denorm_min(),
+            1.0e-40f,
+            std::numeric_limits<float>::min(),
+            std::nextafter(std::numeric_limits<float>::min(), 0.0f),
+            1.0f,
+            1.41421350f,
+            1.41421366f,
+            std::numeric_limits<float>::max(),
+            3.0e19f,
+        };
+        for (int exponent = -149; exponent <= 127; exponent += 7)
+        {
+            const float x = std::ldexp(1.0f, exponent);
+            values.push_back(x);
+            values.push_back(std::nextafter(x, 0.0f));
+            values.push_back(std::nextafter(x, std::numeric_limits<float>::infinity()));
+        }
+        return values;
+    }
+
+    // positive values spread evenly over the exponents, mixed with the edge values
+    std::vector<float> TestValues(std::mt19937& random, size_t count)
+    {
+        static const std::vector<float> edges = EdgeValues();
+        std::uniform_real_distribution<float> exponent(-140.0f, 127.0f);
+        std::uniform_int_distribution<size_t> pick(0, edges.size() * 4);
+
+        std::vector<float> values(count);
+        for (auto& value : values)
+        {
+            const size_t index = pick(random);
+            value = index < edges.size() ? edges[index] : std::exp2(exponent(random));
+        }
+        return values;
+    }
+
+    void TestMagnitudeSquared(std::mt19937& random, const char* level)
+    {
+        double maxError = 0.0;
+        for (const size_t length : Lengths)
+        {
+            const std::vector<float> re = TestValues(random, length);
+            const std::vector<float> im = TestValues(random, length);
+
+            std::vector<cfloat> in(length);
+            for (size_t i = 0; i < length; ++i)
+            {
+                // half of the values are negative and some have a zero part
+                in[i].real = i % 2 ? -re[i] : re[i];
+                in[i].imag = i % 5 == 0 ? 0.0f : im[i];
+            }
+
+            std::vector<float> out(length);
+            SpectrumKernels::MagnitudeSquared(in.data(), out.data(), length);
+
+            for (size_t i = 0; i < length; ++i)
+            {
+                // rounded to float, as the kernel has to
+                const double reference = static_cast<float>(static_cast<double>(in[i].real) * in[i].real + static_cast<double>(in[i].imag) * in[i].imag);
+                if (reference < std::numeric_limits<float>::min() || std::isinf(reference))
+                {
+                    // denormal or overflowing results carry no precision, only their side of the range counts
+                    Expect(reference < std::numeric_limits<float>::min() ? out[i] < std::numeric_limits<float>::min() : std::isinf(out[i]),
+                        level, "MagnitudeSquared", "out of range result " + std::to_string(out[i]));
+                    continue;
+                }
+
+                const double error = DifferenceDb(out[i], reference, 10.0);
+                maxError = std::max(maxError, error);
+                Expect(error <= MaxErrorDb, level, "MagnitudeSquared", std::to_string(out[i]) + " instead of " + std::to_string(reference));
+            }
+        }
+        std::cout << level << " MagnitudeSquared: max error " << maxError << " dB" << std::endl;
+    }
+
+    void TestSumSqrt(std::mt19937& random, const char* level)
+    {
+        double maxError = 0.0;
+        for (const size_t length : Lengths)
+        {
+            // the powers of one band, within a range that a band plan sums
+            std::uniform_real_distribution<float> exponent(-60.0f, 60.0f);
+            std::vector<float> in(length);
+            for (auto& value : in)
+            {
+                value = std::exp2(exponent(random));
+            }
+            in[0] = 0.0f;
+            in[length / 2] = 1.0e-40f;
+
+            double reference = 0.0;
+            for (const float value : in)
+            {
+                reference += std::sqrt(static_cast<double>(value));
+            }
+
+            const float sum = SpectrumKernels::SumSqrt(in.data(), length);
+
+            // the sum of magnitudes is an amplitude
+            const double error = DifferenceDb(sum, reference, 20.0);
+            maxError = std::max(maxError, error);
+            Expect(error <= MaxErrorDb, level, "SumSqrt", std::to_string(sum) + " instead of " + std::to_string(reference) + " over " + std::to_string(length));
+        }
+        std::cout << level << " SumSqrt: max error " << maxError << " dB" << std::endl;
+    }
+
+    void TestLog10(std::mt19937& random, const char* level)
+    {
+        double maxError = 0.0;
+        for (const size_t length : Lengths)
+        {
+            std::vector<float> in = TestValues(random, length);
+            // zeros and negatives, which must come out as -infinity like the denormals
+            for (size_t i = 0; i < length; i += 6)
+            {
+                in[i] = i % 12 ? -in[i] : -0.0f;
+            }
+
+            std::vector<float> out(length);
+            SpectrumKernels::Log10(in.data(), out.data(), length);
+
+            // in place, as the spectrum stage calls it
+            std::vector<float> inPlace = in;
+            SpectrumKernels::Log10(inPlace.data(), inPlace.data(), length);
+
+            for (size_t i = 0; i < length; ++i)
+            {
+                Expect(inPlace[i] == out[i] || (std::isinf(inPlace[i]) && std::isinf(out[i])), level, "Log10", "in place differs at " + std::to_string(in[i]));
+
+                if (!(std::numeric_limits<float>::min() <= in[i]))
+                {
+                    Expect(std::isinf(out[i]) && out[i] < 0.0f, level, "Log10", "log10(" + std::to_string(in[i]) + ") is " + std::to_string(out[i]) + " instead of -inf");
+                    continue;
+                }
+
+                // a log10 error e is 10 * e dB of power
+                const double error = 10.0 * std::abs(out[i] - std::log10(static_cast<double>(in[i])));
+                maxError = std::max(maxError, error);
+                Expect(error <= MaxErrorDb, level, "Log10", "log10(" + std::to_string(in[i]) + ") is " + std::to_string(out[i]));
+            }
+        }
+        std::cout << level << " Log10: max error " << maxError << " dB" << std::endl;
+    }
+
+    void TestS16ToFloat(std::mt19937& random, const char* level)
+    {
+        std::uniform_int_distribution<int> sample(-32768, 32767);
+        const std::int16_t edges[] = {-32768, -32767, -1, 0, 1, 32766, 32767};
+
+        for (const size_t stride : {1, 2, 3, 6})
+        {
+            for (const size_t length : Lengths)
+            {
+                std::vector<std::int16_t> in(length * stride);
+                for (size_t i = 0; i < in.size(); ++i)
+                {
+                    in[i] = i % 4 == 0 ? edges[(i / 4) % std::size(edges)] : static_cast<std::int16_t>(sample(random));
+                }
+
+                for (size_t channel = 0; channel < stride; ++channel)
+                {
+                    std::vector<float> out(length);
+                    SpectrumKernels::S16ToFloat(in.data() + channel, stride, out.data(), length);
+
+                    for (size_t i = 0; i < length; ++i)
+                    {
+                        // the division the capturers did before the kernels, so exactly equal
+                        const float expected = in[i * stride + channel] / 32767.0f;
+                        Expect(out[i] == expected, level, "S16ToFloat",
+                            std::to_string(in[i * stride + channel]) + " became " + std::to_string(out[i]) + " at stride " + std::to_string(stride));
+                    }
+                }
+            }
+        }
+        std::cout << level << " S16ToFloat: exact" << std::endl;
+    }
+}
+
+int main()
+{
+    // before any SetLevel(), GetLevel() is the best level the CPU supports
+    const SpectrumKernels::Level detected = SpectrumKernels::GetLevel();
+
+    for (const auto level : {SpectrumKernels::Level::Scalar, SpectrumKernels::Level::SSE2, SpectrumKernels::Level::AVX2})
+    {
+        if (static_cast<int>(detected) < static_cast<int>(level))
+        {
+            std::cout << "skipping the levels above " << SpectrumKernels::GetLevelName() << ", which this CPU lacks" << std::endl;
+            break;
+        }
+
+        SpectrumKernels::SetLevel(level);
+        if (SpectrumKernels::GetLevel() != level)
+        {
+            // e.g. SSE2 on a non-x86 build
+            continue;
+        }
+
+        const char* name = SpectrumKernels::GetLevelName();
+        std::mt19937 random(12345);
+        TestMagnitudeSquared(random, name);
+        TestSumSqrt(random, name);
+        TestLog10(random, name);
+        TestS16ToFloat(random, name);
+    }
+
+    if (failureCount != 0)
+    {
+        std::cerr << failureCount << " checks failed" << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
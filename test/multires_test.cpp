@@ -0,0 +1,143 @@
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+
+#include "Option.hpp"
+#include "SpectrumAnalyzer.hpp"
+#include "MultiResolutionAnalyzer.hpp"
+#include "SoundCapturerGenerator.hpp"
+
+// Runs the multitone of the generator source through --engine multires and --engine fft with the default
+// options and compares, for every tone on the axis, the band of the peak and its level. The peaks must lie
+// within a bin of the octave the tone is analyzed in, and the levels within 3% of the display range.
+// Then one frame comes after a gap longer than the capture buffer, and every octave must still be filled.
+
+namespace
+{
+    constexpr double MaxLevelDifference = 0.03;
+
+    struct Axis
+    {
+        size_t bandCount;
+        double logFreqMin;
+        double logFreqMax;
+        double logBase;
+
+        // the frequency of a band, as both analyzers lay out the axis
+        double freq(size_t band)const
+        {
+            return std::pow(logFreqMin + (logFreqMax - logFreqMin) * band / bandCount, logBase);
+        }
+
+        // the band with the highest value within a sixth of an octave of freq
+        size_t peak(const std::vector<float>& spectrum, double toneFreq)const
+        {
+            size_t result = bandCount;
+            for (size_t band = 0; band < bandCount; ++band)
+            {
+                const double bandFreq = freq(band);
+                if (toneFreq / 1.12 <= bandFreq && bandFreq <= toneFreq * 1.12 && (result == bandCount || spectrum[result] < spectrum[band]))
+                {
+                    result = band;
+                }
+            }
+            return result;
+        }
+    };
+
+    // the bin spacing of the octave freq is analyzed in: level k covers (rate / 8, rate / 4] of its rate
+    double OctaveBinWidth(const Option& option, double freq)
+    {
+        const size_t levelCount = option.multiResolutionLevels();
+        const double sampleRate = option.samplingFrequency;
+
+        size_t level = 0;
+        while (level + 1 < levelCount && freq <= sampleRate / std::ldexp(8.0, static_cast<int>(level)))
+        {
+            ++level;
+        }
+        return sampleRate / std::ldexp(static_cast<double>(option.octaveFftSize), static_cast<int>(level));
+    }
+
+    int Compare(const Option& option, const Axis& axis, const std::vector<float>& fft, const std::vector<float>& multires, const char* when)
+    {
+        int failureCount = 0;
+
+        // the tones of the multitone signal
+        for (double tone = 62.5; tone < option.samplingFrequency / 2.0; tone *= 4.0)
+        {
+            if (tone < option.minFreq || option.maxFreq < tone)
+            {
+                continue;
+            }
+
+            const size_t fftPeak = axis.peak(fft, tone);
+            const size_t multiresPeak = axis.peak(multires, tone);
+            const double freqDifference = std::abs(axis.freq(fftPeak) - axis.freq(multiresPeak));
+            const double levelDifference = std::abs(fft[fftPeak] - multires[multiresPeak]);
+
+            std::cout << when << ": " << tone << " Hz peak at " << axis.freq(fftPeak) << " Hz (fft) and " << axis.freq(multiresPeak)
+                << " Hz (multires), levels " << fft[fftPeak] << " and " << multires[multiresPeak] << std::endl;
+
+            if (!(freqDifference <= OctaveBinWidth(option, tone)))
+            {
+                std::cerr << "FAIL " << when << ": the peaks of " << tone << " Hz are " << freqDifference << " Hz apart" << std::endl;
+                ++failureCount;
+            }
+
+            // a tone inside the display range, so that neither level is clamped
+            if (!(0.02f < fft[fftPeak] && fft[fftPeak] < 0.98f) || !(levelDifference <= MaxLevelDifference))
+            {
+                std::cerr << "FAIL " << when << ": the levels of " << tone << " Hz are " << fft[fftPeak] << " and " << multires[multiresPeak] << std::endl;
+                ++failureCount;
+            }
+        }
+
+        return failureCount;
+    }
+}
+
+int main()
+{
+    const char* argv[] = {"multires_test", "--engine", "multires", "--source", "generator", "--signal", "multitone", "--realtime", "off"};
+
+    Option option;
+    if (!option.init(static_cast<int>(std::size(argv)), argv) || !option.isInitialized())
+    {
+        return 1;
+    }
+
+    const int sampleRate = option.samplingFrequency;
+    const size_t bandCount = option.fftSize - 1;
+    const Axis axis{bandCount, std::pow(option.minFreq, 1.0 / option.axisLogBase), std::pow(option.maxFreq, 1.0 / option.axisLogBase), option.axisLogBase};
+
+    SoundCapturerGenerator generator(option.signal, 1, option.signalSpeed, option.signalDuration, option.realtime);
+    generator.init(option.captureBufferSize(sampleRate), sampleRate);
+    generator.setHopSize(static_cast<size_t>(sampleRate / option.fps));
+
+    SpectrumAnalyzer fft(option.inputSize, option.fftSize, sampleRate, option.windowType);
+    MultiResolutionAnalyzer multires(option.octaveFftSize, option.multiResolutionLevels(), bandCount, sampleRate, option.windowType);
+
+    const auto update = [&]
+    {
+        generator.update();
+        fft.update(generator.getBuffer(), generator.bufferHeadIndex(), option.bottomLevel, option.topLevel, option.minFreq, option.maxFreq, option.axisLogBase);
+        multires.update(generator.getBuffer(), generator.bufferHeadIndex(), generator.bufferReadCount(),
+            option.bottomLevel, option.topLevel, option.minFreq, option.maxFreq, option.axisLogBase);
+    };
+
+    // a second, so that the lowest octave has been filled many times over
+    for (int frame = 0; frame < static_cast<int>(option.fps); ++frame)
+    {
+        update();
+    }
+    int failureCount = Compare(option, axis, fft.spectrum(), multires.spectrum(), "steady");
+
+    // a frame two seconds late
+    generator.setHopSize(sampleRate * 2);
+    update();
+    failureCount += Compare(option, axis, fft.spectrum(), multires.spectrum(), "after a gap");
+
+    return failureCount == 0 ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+#include <vector>
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include "SlidingDftAnalyzer.hpp"
+
+// Feeds SlidingDftAnalyzer 20 s of tones and noise in frames of varying size, one of them longer than the
+// capture buffer, and compares its levels with a direct Hann-windowed DFT of the same samples in double.
+// The recursion runs over every sample, so this also bounds the rounding it accumulates.
+
+namespace
+{
+    constexpr double Pi = 3.14159265358979323846;
+    constexpr int SampleRate = 48000;
+    constexpr size_t WindowSize = 2048;
+    constexpr double Seconds = 20.0;
+
+    // the levels are 10 * log10 of a magnitude, and within this of the direct DFT
+    constexpr double MaxErrorDb = 1.0e-4;
+
+    // level of the direct DFT of the latest windowSize samples, with the window of SlidingDftAnalyzer:
+    // 0.5 - 0.5 cos(2 pi m / N) over the age m of the sample, the newest being 0
+    double DirectLevel(const std::vector<float>& samples, float freq)
+    {
+        const double theta = 2.0 * Pi * freq / SampleRate;
+        double re = 0.0;
+        double im = 0.0;
+        for (size_t m = 0; m < WindowSize; ++m)
+        {
+            const double x = m < samples.size() ? samples[samples.size() - 1 - m] : 0.0;
+            const double w = 0.5 - 0.5 * std::cos(2.0 * Pi * m / WindowSize);
+            re += w * x * std::cos(theta * m);
+            im -= w * x * std::sin(theta * m);
+        }
+
+        const double magnitude = 2.0 / WindowSize * std::sqrt(re * re + im * im);
+        return 10.0 * std::log10(BandPlan::DWeighting(freq) * magnitude);
+    }
+}
+
+int main()
+{
+    // on a bin, between bins, without a tone, and close to the Nyquist frequency
+    const std::vector<float> tracked = {50.0f, 1000.0f, 1010.7f, 3000.0f, 5000.0f, 23900.0f};
+    const std::vector<float> tones = {50.0f, 1010.7f, 3000.0f, 23900.0f};
+
+    // a frame period at 60 fps, and half a second more
+    const size_t bufferSize = WindowSize + SampleRate / 60 + SampleRate / 2;
+
+    SlidingDftAnalyzer analyzer(tracked, WindowSize, 64, SampleRate);
+
+    std::vector<float> buffer(bufferSize);
+    size_t headIndex = 0;
+    size_t readCount = 0;
+
+    // the samples the analyzer has consumed, which the direct DFT is taken of
+    std::vector<float> fed;
+
+    std::mt19937 random(7);
+    std::normal_distribution<float> noise(0.0f, 1.0e-3f);
+    std::uniform_int_distribution<size_t> frameSize(1, SampleRate / 20);
+
+    const size_t totalCount = static_cast<size_t>(Seconds * SampleRate);
+    const size_t gapFrame = 100;
+
+    int failureCount = 0;
+    double maxError = 0.0;
+
+    for (size_t frame = 0; readCount < totalCount; ++frame)
+    {
+        // one frame comes so late that the buffer has overwritten samples it had not consumed yet
+        const size_t count = frame == gapFrame ? bufferSize + SampleRate / 3 : frameSize(random);
+
+        for (size_t i = 0; i < count; ++i, ++readCount)
+        {
+            const double t = static_cast<double>(readCount) / SampleRate;
+            float x = noise(random);
+            for (const float freq : tones)
+            {
+                x += 0.2f * static_cast<float>(std::sin(2.0 * Pi * freq * t));
+            }
+
+            buffer[headIndex] = x;
+            headIndex = headIndex + 1 == bufferSize ? 0 : headIndex + 1;
+        }
+
+        // the analyzer goes on with what the buffer still holds
+        const size_t consumed = std::min(count, bufferSize);
+        for (size_t i = 0; i < consumed; ++i)
+        {
+            fed.push_back(buffer[(headIndex + bufferSize - consumed + i) % bufferSize]);
+        }
+
+        analyzer.update(buffer, headIndex, readCount, -60.0f, 0.0f, 20.0f, 24000.0f, 10.0f);
+
+        if (frame % 50 != 0 && frame != gapFrame)
+        {
+            continue;
+        }
+
+        for (size_t i = 0; i < tracked.size(); ++i)
+        {
+            const double expected = DirectLevel(fed, tracked[i]);
+            const double level = analyzer.trackedLevels()[i];
+            const double error = std::abs(level - expected);
+            maxError = std::max(maxError, error);
+
+            if (!(error <= MaxErrorDb) && ++failureCount <= 20)
+            {
+                std::cerr << "FAIL " << tracked[i] << " Hz after " << readCount << " samples: " << level << " dB instead of " << expected << " dB" << std::endl;
+            }
+        }
+
+        // only the window is needed for the reference
+        if (WindowSize * 4 < fed.size())
+        {
+            fed.erase(fed.begin(), fed.end() - WindowSize);
+        }
+    }
+
+    std::cout << "sliding DFT: max error " << maxError << " dB against the direct DFT after " << readCount << " samples" << std::endl;
+
+    return failureCount == 0 ? 0 : 1;
+}